@@ -11,7 +11,11 @@ std::string CatString(std::vector<std::string> v) {
 }
 int main(int argc, char **argv) {
 
-  std::shared_ptr<RpcServer> server(new RpcServer);
+  TcpServerOptions options;
+  options.port = 2468;
+  options.numLoops = 4;
+  options.threadName = "rpc-io";
+  std::shared_ptr<RpcServer> server(new RpcServer(options));
   std::string str = "lambda";
   // acid::Address::ptr address = acid::Address::LookupAny("127.0.0.1:8081");
   server->registerMethod("add", add);
@@ -1,34 +1,77 @@
-#include "fcntl.h"
-
 #include "Acceptor.hpp"
 #include "EventLoop.hpp"
 #include "Poller.hpp"
 
+Acceptor::~Acceptor() {
+  if (local_sock_ != kInvaild_)
+    ::close(local_sock_);
+  if (idle_fd_ != kInvaild_)
+    ::close(idle_fd_);
+}
+
 int Acceptor::Identifier() const { return local_sock_; }
 
-void Acceptor::BindAndListen() {
-  struct sockaddr_in addr;
+// 路径上的 socket 文件没有进程在监听 (connect 被拒绝) 时才算遗留的
+static bool _IsStaleUnixPath(const sockaddr *addr, socklen_t len) {
+  int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (probe < 0)
+    return false;
+  // 非阻塞 connect 在对方 accept 队列满时返回 EAGAIN, 同样视为在用
+  const bool stale = ::connect(probe, addr, len) < 0 && errno == ECONNREFUSED;
+  ::close(probe);
+  return stale;
+}
 
-  local_port_ = 2468;
-  addr.sin_family = AF_INET;
-  addr.sin_addr.s_addr = htonl(INADDR_ANY);
-  addr.sin_port = htons(local_port_);
-  // create TCP socket
-  local_sock_ = socket(AF_INET, SOCK_STREAM, 0);
+void Acceptor::BindAndListen(const std::string &ip, uint16_t port, int backlog,
+                             bool reusePort) {
+  struct sockaddr_storage addr;
+  socklen_t len;
+  local_port_ = port;
+  if (!ResolveAddress(ip, port, &addr, &len)) {
+    printf("invalid listen address %s\n", ip.c_str());
+    assert(false);
+  }
+  // create TCP or Unix stream socket
+  local_sock_ =
+      socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if (local_sock_ < 0) {
-    printf("failed create TCP listen\n");
+    printf("failed create listen socket\n");
   } else {
-    printf("create TCP listen success\n");
+    printf("create listen socket success\n");
+  }
+  ApplyListenOptions(local_sock_, options_);
+  if (addr.ss_family == AF_UNIX) {
+    // 文件系统路径可能是上次运行遗留的, 抽象地址随 socket 关闭消失;
+    // 仍有服务在监听时保留, 让下面的 bind 以 EADDRINUSE 失败
+    auto un = reinterpret_cast<sockaddr_un *>(&addr);
+    if (un->sun_path[0] != '\0' &&
+        _IsStaleUnixPath((const sockaddr *)&addr, len))
+      ::unlink(un->sun_path);
+  } else if (reusePort) {
+    int on = 1;
+    ::setsockopt(local_sock_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
   }
-  int ret = ::bind(local_sock_, (struct sockaddr *)&addr, sizeof(addr));
-  if (ret < 0)
+  int ret = ::bind(local_sock_, (struct sockaddr *)&addr, len);
+  if (ret < 0) {
+    printf("bind %s failed: %s\n", ip.c_str(), strerror(errno));
     assert(false);
-  ret = ::listen(local_sock_, 1024);
-  fcntl(local_sock_, F_SETFL, fcntl(local_sock_, F_GETFD, 0) | O_NONBLOCK);
+  }
+  ret = ::listen(local_sock_, backlog);
+}
+
+void Acceptor::Adopt(int listenFd) {
+  assert(local_sock_ == kInvaild_);
+  local_sock_ = listenFd;
+  SetNonBlock(local_sock_);
+  sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (::getsockname(local_sock_, (sockaddr *)&addr, &len) == 0 &&
+      addr.sin_family == AF_INET)
+    local_port_ = ntohs(addr.sin_port);
 }
 
 bool Acceptor::HandleReadEvent() {
-  while (true) {
+  for (int i = 0; i < kMaxAcceptPerEvent_; ++i) {
     int connfd = _Accept();
     if (connfd != kInvaild_) {
       // 多态创建新线程
@@ -46,7 +89,11 @@ bool Acceptor::HandleReadEvent() {
         break;
       case EMFILE:
       case ENFILE:
-        return true;
+        // 不处理的话连接一直留在监听队列, 监听 socket 持续可读
+        if (!_DropOnExhausted())
+          return true;
+        goAhead = true;
+        break;
       case ENOBUFS:
       case ENOMEM:
         return true; // not enough memory
@@ -66,6 +113,56 @@ bool Acceptor::HandleReadEvent() {
   return true;
 }
 
+/**
+ * @brief fd 耗尽时释放预留 fd，accept 一个连接并立即关闭，再重新预留
+ *
+ * 对端会收到连接关闭，而不是一直停留在 backlog 中等待超时
+ */
+bool Acceptor::_DropOnExhausted() {
+  if (idle_fd_ == kInvaild_) // 上次没能重新预留, 再试一次
+    idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (idle_fd_ == kInvaild_) {
+    _PauseAccept();
+    return false;
+  }
+  ::close(idle_fd_);
+  int connfd = ::accept(local_sock_, nullptr, nullptr);
+  if (connfd != kInvaild_)
+    ::close(connfd);
+  idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  printf("Acceptor: file descriptors exhausted, drop new connection\n");
+  return connfd != kInvaild_;
+}
+
+/**
+ * @brief 没有预留 fd 可用时暂停关注可读
+ *
+ * 监听 socket 是水平触发的，连接留在 backlog 中会让每一轮 loop 都收到
+ * 可读事件而空转；暂停一段时间后再恢复，期间可能已有 fd 被释放
+ */
+void Acceptor::_PauseAccept() {
+  if (paused_)
+    return;
+  paused_ = true;
+  printf("Acceptor: no spare file descriptor, pause accepting for %ldms\n",
+         static_cast<long>(kPauseOnExhausted_.count()));
+  loop_->Modify(EPOLL_ET_Level, this);
+  std::weak_ptr<Channel> weak = weak_from_this();
+  loop_->RunAfter(kPauseOnExhausted_, [weak]() {
+    if (auto self = weak.lock())
+      static_cast<Acceptor *>(self.get())->_ResumeAccept();
+  });
+}
+
+void Acceptor::_ResumeAccept() {
+  paused_ = false;
+  if (idle_fd_ == kInvaild_)
+    idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+  // 暂停期间可能已被注销 (Stop 或交接)
+  if (loop_->IsRegistered(this))
+    loop_->Modify(EPOLL_ET_Read | EPOLL_ET_Level, this);
+}
+
 bool Acceptor::HandleWriteEvent() {
   assert(false);
   return false;
@@ -1,11 +1,17 @@
+#ifndef SNOWY_ACCEPTOR_H
+#define SNOWY_ACCEPTOR_H
 
 #include <arpa/inet.h>
 
 #include <atomic>
+#include <chrono>
+#include <string>
 #include <vector>
 
 #include <cassert>
 
+#include <fcntl.h>
+
 #include "Channel.hpp"
 #include "Connection.hpp"
 
@@ -19,9 +25,16 @@ private:
   int local_sock_;
   uint16_t local_port_;
   sockaddr_in peer_;
+  int idle_fd_; // 预留 fd, 进程 fd 耗尽时用于 accept 后立即关闭
+  bool paused_ = false; // fd 耗尽且没有预留 fd, 暂时不关注可读
+  SocketOptions options_;
 
   static const int kInvaild_ = -1;
   static const uint16_t kInvalidPort_ = -1;
+  // 每次可读事件最多 accept 的连接数, 监听 socket 以水平触发注册,
+  // 剩余连接在下一轮 loop 继续处理
+  static const int kMaxAcceptPerEvent_ = 64;
+  static constexpr std::chrono::milliseconds kPauseOnExhausted_{100};
 
   using MakeNewConnection =
       std::function<void(int connfd, const sockaddr_in &peer)>;
@@ -33,8 +46,21 @@ public:
     local_sock_ = kInvaild_;
     local_port_ = kInvalidPort_;
     current_loop_ind_.store(0);
+    idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
   }
-  void BindAndListen();
+  ~Acceptor();
+  /**
+   * @brief ip 为 "unix:<path>" 时监听 Unix 域 stream socket (忽略 port 与
+   * reusePort)，path 以 '@' 开头为抽象命名空间；文件路径已存在时只在没有
+   * 进程监听时删除, 否则 bind 失败。reusePort 为 true 时设置
+   * SO_REUSEPORT, 多个 Acceptor 可监听同一端口
+   */
+  void BindAndListen(const std::string &ip, uint16_t port, int backlog = 1024,
+                     bool reusePort = false);
+  ///@brief 需在 BindAndListen 之前设置
+  void SetSocketOptions(const SocketOptions &options) { options_ = options; }
+  ///@brief 接管已处于监听状态的 fd (如从旧进程交接而来), 之后由本对象关闭
+  void Adopt(int listenFd);
 
 public:
   int Identifier() const override;
@@ -48,7 +74,22 @@ public:
 
 private:
   int _Accept() {
-    socklen_t addrlen = sizeof(peer_);
-    return ::accept(local_sock_, (struct sockaddr *)&peer_, &addrlen);
+    // Unix 域对端地址放不进 sockaddr_in, 只保留地址族
+    sockaddr_storage addr;
+    addr.ss_family = AF_UNSPEC;
+    socklen_t addrlen = sizeof(addr);
+    int connfd = ::accept4(local_sock_, (struct sockaddr *)&addr, &addrlen,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    ::memset(&peer_, 0, sizeof(peer_));
+    if (addr.ss_family == AF_INET)
+      ::memcpy(&peer_, &addr, sizeof(peer_));
+    else
+      peer_.sin_family = addr.ss_family;
+    return connfd;
   }
-};
\ No newline at end of file
+  bool _DropOnExhausted();
+  void _PauseAccept();
+  void _ResumeAccept();
+};
+
+#endif
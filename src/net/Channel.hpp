@@ -31,6 +31,11 @@ public:
   virtual bool HandleWriteEvent() = 0;
   ///@brief When error event occurs
   virtual void HandleErrorEvent() = 0;
+  /**
+   * @brief When EPOLLERR occurs, e.g. MSG_ZEROCOPY completions are queued
+   * @return false 表示不是错误队列通知, 按 HandleErrorEvent 处理
+   */
+  virtual bool HandleErrQueueEvent() { return false; }
 };
 
 #endif
\ No newline at end of file
@@ -9,6 +9,11 @@
  *
  */
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <time.h> // linux/errqueue.h 需要 timespec
+#include <linux/errqueue.h>
+
 #include <cassert>
 #include <iostream>
 
@@ -17,32 +22,77 @@
 Connection::Connection(std::shared_ptr<EventLoop> loop)
     : loop_(loop), local_sock_(kInvalid_) {}
 
+Connection::~Connection() {
+  if (local_sock_ != kInvalid_) {
+    ::close(local_sock_);
+    loop_->RemoveConnection();
+  }
+}
+
 bool Connection::Init(int sock, const sockaddr_in &peer) {
   if (sock == kInvalid_)
     return false;
 
+  // sock 须已是非阻塞的: accept4(SOCK_NONBLOCK) 或由调用者设置
   local_sock_ = sock;
   peer_ = peer;
-  SetNonBlock(local_sock_);
+  loop_->AddConnection();
+  if (int us = loop_->SocketBusyPollUs(); us > 0) {
+    // 可能需要 CAP_NET_ADMIN, 失败不影响正常收发
+    ::setsockopt(local_sock_, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us));
+  }
   assert(state_ == State::None);
   state_ = State::Connected;
   return true;
 }
 
+bool Connection::Detach(int *fd, sockaddr_in *peer, std::string *pending) {
+  assert(loop_->IsRunningThisLoop());
+  if (state_ != State::Connected || !send_buf_.empty() ||
+      send_buf_.PendingZeroCopy() > 0)
+    return false;
+  loop_->Unregister(EPOLL_ET_Read | EPOLL_ET_Write, this);
+  pending->assign(recv_buf_.readAddr(), recv_buf_.readableSize());
+  recv_buf_.clear();
+  *fd = local_sock_;
+  *peer = peer_;
+  local_sock_ = kInvalid_;
+  loop_->RemoveConnection();
+  state_ = State::Closed;
+  return true;
+}
+
+void Connection::InjectReceived(const std::string &data) {
+  if (data.empty() || state_ != State::Connected)
+    return;
+  recv_buf_.pushData(data.data(), data.size());
+  processMessage();
+}
+
+bool Connection::CloseIfIdle() {
+  if (state_ != State::Connected || !send_buf_.empty() ||
+      send_buf_.PendingZeroCopy() > 0 || recv_buf_.readableSize() > 0)
+    return false;
+  _Shutdown(ShutdownMode::SM_BOTH);
+  state_ = State::Closed;
+  loop_->Unregister(EPOLL_ET_Read | EPOLL_ET_Write, this);
+  return true;
+}
+
 int Connection::Identifier() const { return local_sock_; }
 
 bool Connection::HandleReadEvent() {
   if (state_ != State::Connected) {
     return false;
   }
-  while (true) {
-    recv_buf_.AssureSpace(1024);
-    int bytes =
-        ::recv(local_sock_, recv_buf_.writeAddr(), recv_buf_.writableSize(), 0);
+  _QuickAck();
+  // 发送缓冲超过高水位时暂停读取, 待回落到低水位后由 HandleWriteEvent 恢复
+  while (!readPaused_) {
+    ssize_t bytes = recv_buf_.readFd(local_sock_);
     // nothing to read
     if (bytes == kInvalid_) {
       if (EAGAIN == errno || EWOULDBLOCK == errno)
-        return true;
+        break;
       if (EINTR == errno)
         continue; // restart ::recv
       _Shutdown(ShutdownMode::SM_BOTH);
@@ -57,32 +107,180 @@ bool Connection::HandleReadEvent() {
       } else {
         state_ = State::CloseWaitWrite;
         _Shutdown(ShutdownMode::SM_READ);
-        loop_->Modify(EPOLL_ET_Write, shared_from_this()); // disable read
+        _UpdateEvents(); // disable read
       }
       return false;
     }
-    if (bytes > 0) {
-      // just echo
-      recv_buf_.produce(bytes);
-      processMessage();
-    }
-    if (send_buf_.readableSize() > 0) {
-      loop_->Modify(EPOLL_ET_Write, shared_from_this());
-    }
+    _QuickAck(); // 立即发出刚读到数据的 ACK
+    processMessage();
   }
   return true;
 }
 
+void Connection::_QuickAck() {
+  // TCP_QUICKACK 不是永久的, 内核发出数据后会退回延迟确认, 因此每次
+  // 读取前后都要重新设置
+  if (!quickAck_)
+    return;
+  int on = 1;
+  ::setsockopt(local_sock_, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+}
+
 bool Connection::HandleWriteEvent() {
-  while (send_buf_.readableSize() > 0) {
-    int len =
-        ::send(local_sock_, send_buf_.readAddr(), send_buf_.readableSize(), 0);
-    send_buf_.consume(len);
+  if (state_ != State::Connected && state_ != State::CloseWaitWrite)
+    return false;
+  if (!_FlushSendBuf()) {
+    _Shutdown(ShutdownMode::SM_BOTH);
+    state_ = State::Error;
+    return false;
   }
-  loop_->Modify(EPOLL_ET_Read, shared_from_this());
+  if (send_buf_.empty() && state_ == State::CloseWaitWrite) {
+    // 对端已关闭, 残留数据发完后关闭连接
+    _Shutdown(ShutdownMode::SM_BOTH);
+    state_ = State::PassiveClose;
+    return false;
+  }
+  if (readPaused_ && send_buf_.readableSize() <= lowWatermark_)
+    readPaused_ = false; // 重新关注 EPOLLIN, 若已有数据会再次触发可读
+  _UpdateEvents();
+  if (send_buf_.empty() && onWriteComplete_)
+    onWriteComplete_();
   return true;
 }
 
+void Connection::SetWatermarks(std::size_t low, std::size_t high) {
+  assert(low <= high);
+  lowWatermark_ = low;
+  highWatermark_ = high;
+}
+
+bool Connection::Send(const void *data, std::size_t len) {
+  assert(loop_->IsRunningThisLoop());
+  if (state_ != State::Connected)
+    return false;
+  const char *ptr = static_cast<const char *>(data);
+  std::size_t sent = 0;
+  // write-through: 没有排队数据时直接发送, 只缓存 EAGAIN 后未发出的部分
+  if (send_buf_.empty()) {
+    while (sent < len) {
+      ssize_t n = ::send(local_sock_, ptr + sent, len - sent, MSG_NOSIGNAL);
+      if (n > 0) {
+        sent += n;
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      } else {
+        _Shutdown(ShutdownMode::SM_BOTH);
+        state_ = State::Error;
+        return false;
+      }
+    }
+  }
+  if (sent < len) {
+    const bool wasEmpty = send_buf_.empty();
+    const std::size_t before = send_buf_.readableSize();
+    send_buf_.AppendCopy(ptr + sent, len - sent);
+    // 直接发送已经写到 EAGAIN, 无需再试
+    return _OnQueued(wasEmpty, before, false);
+  }
+  return true;
+}
+
+bool Connection::Send(const IoSlice *slices, std::size_t count) {
+  assert(loop_->IsRunningThisLoop());
+  if (state_ != State::Connected)
+    return false;
+  const bool wasEmpty = send_buf_.empty();
+  const std::size_t before = send_buf_.readableSize();
+  for (std::size_t i = 0; i < count; ++i)
+    send_buf_.Append(slices[i]);
+  return _OnQueued(wasEmpty, before);
+}
+
+bool Connection::SendFile(int fd, off_t offset, std::size_t len) {
+  assert(loop_->IsRunningThisLoop());
+  if (state_ != State::Connected)
+    return false;
+  const bool wasEmpty = send_buf_.empty();
+  const std::size_t before = send_buf_.readableSize();
+  if (!send_buf_.AppendFile(fd, offset, len))
+    return false;
+  return _OnQueued(wasEmpty, before);
+}
+
+bool Connection::_OnQueued(bool wasEmpty, std::size_t before, bool flush) {
+  // 原本有排队数据时可写事件已在关注中, 只追加不发送, 保证顺序
+  if (wasEmpty && flush && !_FlushSendBuf()) {
+    _Shutdown(ShutdownMode::SM_BOTH);
+    state_ = State::Error;
+    return false;
+  }
+  if (send_buf_.empty())
+    return true;
+  const std::size_t after = send_buf_.readableSize();
+  const bool crossed = before < highWatermark_ && after >= highWatermark_;
+  if (crossed) {
+    if (pauseReadOnHighWatermark_)
+      readPaused_ = true;
+    if (onHighWatermark_)
+      onHighWatermark_(after);
+  }
+  // 队列由空变为非空时关注可写, 刚越过高水位时取消可读
+  if (wasEmpty || (crossed && readPaused_))
+    _UpdateEvents();
+  return true;
+}
+
+bool Connection::_FlushSendBuf() {
+  if (!send_buf_.Flush(local_sock_))
+    return false;
+  if (!send_buf_.SourceStalled()) {
+    sourceRetry_ = sourceWaited_ = std::chrono::milliseconds(0);
+    return true;
+  }
+  // 如对端从不写入的管道, 一直重试只会让连接永远挂着
+  if (sourceWaited_ >= sourceStallTimeout_) {
+    printf("sendfile source idle for %lldms, close connection\n",
+           static_cast<long long>(sourceWaited_.count()));
+    return false;
+  }
+  _RetrySourceLater();
+  return true;
+}
+
+void Connection::_RetrySourceLater() {
+  // socket 仍可写, 边沿触发不会再通知; 读端 fd 不一定支持 poll, 用定时器
+  if (sourceTimer_ != 0)
+    return;
+  sourceRetry_ = sourceRetry_.count() == 0
+                     ? std::chrono::milliseconds(1)
+                     : std::min(sourceRetry_ * 2, std::chrono::milliseconds(64));
+  sourceWaited_ += sourceRetry_;
+  std::weak_ptr<Channel> weak = weak_from_this();
+  sourceTimer_ = loop_->RunAfter(sourceRetry_, [weak]() {
+    auto self = weak.lock();
+    if (!self)
+      return;
+    auto conn = static_cast<Connection *>(self.get());
+    conn->sourceTimer_ = 0;
+    if (conn->state_ != State::Connected &&
+        conn->state_ != State::CloseWaitWrite)
+      return;
+    if (!conn->HandleWriteEvent())
+      conn->HandleErrorEvent();
+  });
+}
+
+void Connection::_UpdateEvents() {
+  int events = EPOLL_ET_None;
+  if (state_ == State::Connected && !readPaused_)
+    events |= EPOLL_ET_Read;
+  if (!send_buf_.empty())
+    events |= EPOLL_ET_Write;
+  loop_->Modify(events, this);
+}
+
 void Connection::HandleErrorEvent() {
   switch (state_) {
   case State::PassiveClose:
@@ -96,7 +294,44 @@ void Connection::HandleErrorEvent() {
     return;
   }
   state_ = State::Closed;
-  loop_->Unregister(EPOLL_ET_Read | EPOLL_ET_Write, shared_from_this());
+  loop_->Unregister(EPOLL_ET_Read | EPOLL_ET_Write, this);
+}
+
+bool Connection::EnableZeroCopy(std::size_t threshold) {
+  int on = 1;
+  if (::setsockopt(local_sock_, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) != 0)
+    return false;
+  zeroCopy_ = true;
+  send_buf_.EnableZeroCopy(threshold);
+  return true;
+}
+
+bool Connection::HandleErrQueueEvent() {
+  if (!zeroCopy_)
+    return false;
+  char control[128];
+  while (true) {
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = ::recvmsg(local_sock_, &msg, MSG_ERRQUEUE);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK; // 已读完
+    for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        continue;
+      auto err = reinterpret_cast<sock_extended_err *>(CMSG_DATA(cm));
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        return false; // 真正的 socket 错误
+      // ee_info..ee_data 为完成的发送序号区间
+      send_buf_.CompleteZeroCopy(err->ee_info, err->ee_data);
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        ++zeroCopyCopied_;
+    }
+  }
 }
 
 void Connection::_Shutdown(ShutdownMode mode) {
@@ -120,5 +355,5 @@ void Connection::processMessage() {
   buf.resize(recv_buf_.readableSize());
   recv_buf_.popData(&buf[0], buf.size());
   std::cout << buf << std::endl;
-  send_buf_.pushData(&buf[0], buf.size());
+  Send(&buf[0], buf.size());
 }
\ No newline at end of file
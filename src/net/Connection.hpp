@@ -12,9 +12,12 @@
 #define SNOWY_CONNECTION_H
 #include <arpa/inet.h>
 
+#include <functional>
+
 #include "Buffer.hpp"
 #include "Channel.hpp"
 #include "EventLoop.hpp"
+#include "OutputQueue.hpp"
 
 class Connection : public Channel {
 private:
@@ -42,23 +45,122 @@ protected:
 
 protected:
   Buffer recv_buf_;
-  Buffer send_buf_;
+  OutputQueue send_buf_;
+
+public:
+  using HighWatermarkCallback = std::function<void(std::size_t queued)>;
+  using WriteCompleteCallback = std::function<void()>;
+
+private:
+  static const std::size_t kDefaultHighWatermark_ = 64 * 1024 * 1024;
+  std::size_t highWatermark_ = kDefaultHighWatermark_;
+  std::size_t lowWatermark_ = kDefaultHighWatermark_ / 2;
+  bool pauseReadOnHighWatermark_ = false;
+  bool readPaused_ = false;
+  bool zeroCopy_ = false;
+  bool quickAck_ = false;
+  // 文件区间读端暂时无数据时的重试定时器、退避间隔与已等待的时间
+  TimerId sourceTimer_ = 0;
+  std::chrono::milliseconds sourceRetry_{0};
+  std::chrono::milliseconds sourceWaited_{0};
+  std::chrono::milliseconds sourceStallTimeout_{30000};
+  uint64_t zeroCopyCopied_ = 0;
+  HighWatermarkCallback onHighWatermark_;
+  WriteCompleteCallback onWriteComplete_;
 
 public:
   explicit Connection(std::shared_ptr<EventLoop> loop);
-  //~Connection();
+  ~Connection();
   Connection(const Connection &) = delete;
   void operator=(const Connection &) = delete;
   bool Init(int sock, const sockaddr_in &peer);
 
+  /**
+   * @brief 把空闲连接的 socket 交出去 (进程间交接)，只能在 loop 线程调用
+   *
+   * 只有已连接、发送队列为空且没有未完成零拷贝的连接可以交出。成功后
+   * 连接从 loop 注销，不再拥有 fd，recv_buf_ 中未处理的数据写入 pending。
+   */
+  bool Detach(int *fd, sockaddr_in *peer, std::string *pending);
+  ///@brief 交接过来的连接把旧进程已读到的数据放回 recv_buf_ 并处理
+  void InjectReceived(const std::string &data);
+  ///@brief 收发缓冲都为空时关闭连接, 用于进程退出前逐个关闭空闲连接
+  bool CloseIfIdle();
+
 public:
   int Identifier() const override;
   bool HandleReadEvent() override;
   bool HandleWriteEvent() override;
   void HandleErrorEvent() override;
+  bool HandleErrQueueEvent() override;
   virtual void processMessage();
 
+  /**
+   * @brief 发送数据，只能在所属 loop 线程调用
+   *
+   * 发送缓冲为空时直接 ::send，只有 EAGAIN 后剩余的部分拷贝进 send_buf_，
+   * 并在此时才关注可写事件。
+   */
+  bool Send(const void *data, std::size_t len);
+  /**
+   * @brief 发送若干分片，只能在所属 loop 线程调用
+   *
+   * 分片按引用进入发送队列，与已排队数据一起用 sendmsg 批量写出，
+   * 未写完的部分保留 owner 直到发送完成，不做拷贝。
+   */
+  bool Send(const IoSlice *slices, std::size_t count);
+  /**
+   * @brief 发送文件区间 [offset, offset + len)，只能在所属 loop 线程调用
+   *
+   * 与 Send 的数据按调用顺序交错发送，普通文件走 sendfile，其他 fd 经管道
+   * splice，数据不经过用户态。内部 dup 一份 fd，调用后即可关闭。管道等
+   * 读端暂时无数据时以 1ms 起、至多 64ms 的退避间隔重试，累计等待超过
+   * SetSourceStallTimeout 设置的时间后放弃并关闭连接。
+   */
+  bool SendFile(int fd, off_t offset, std::size_t len);
+  ///@brief SendFile 读端持续无数据的最长等待时间, 默认 30s
+  void SetSourceStallTimeout(std::chrono::milliseconds timeout) {
+    sourceStallTimeout_ = timeout;
+  }
+
+  /**
+   * @brief 发送缓冲水位, 需满足 low <= high
+   *
+   * 排队数据由低于 high 变为不低于 high 时调用 onHighWatermark；开启
+   * pauseRead 时同时停止关注可读事件，直到排队数据降到 low 以下。
+   */
+  void SetWatermarks(std::size_t low, std::size_t high);
+  void SetPauseReadOnHighWatermark(bool on) { pauseReadOnHighWatermark_ = on; }
+  void SetHighWatermarkCallback(HighWatermarkCallback cb) {
+    onHighWatermark_ = std::move(cb);
+  }
+  ///@brief 排队数据全部写入内核后调用
+  void SetWriteCompleteCallback(WriteCompleteCallback cb) {
+    onWriteComplete_ = std::move(cb);
+  }
+  /**
+   * @brief 不小于 threshold 的分片发送改用 MSG_ZEROCOPY
+   *
+   * 只对 Send(const IoSlice *, n) 的引用分片生效，分片在内核报告完成前
+   * 不会释放。内核或 socket 不支持时返回 false。
+   */
+  bool EnableZeroCopy(std::size_t threshold = 64 * 1024);
+  ///@brief 内核回退为拷贝发送的零拷贝次数, 回环连接上总是回退
+  uint64_t ZeroCopyCopied() const { return zeroCopyCopied_; }
+  std::size_t QueuedBytes() const { return send_buf_.readableSize(); }
+  bool ReadPaused() const { return readPaused_; }
+  ///@brief 收到数据后立即确认, 只对 TCP 连接有效, 见 SocketOptions::quickAck
+  void SetQuickAck(bool on) { quickAck_ = on; }
+
 protected:
   void _Shutdown(ShutdownMode mode);
+  bool _FlushSendBuf();
+  ///@brief 按当前状态与发送缓冲计算关注的事件
+  void _UpdateEvents();
+  void _QuickAck();
+  ///@brief 发送队列停在无数据的读端上, 定时重试
+  void _RetrySourceLater();
+  ///@brief 数据进入发送队列后立即尝试发送, 检查高水位并关注可写
+  bool _OnQueued(bool wasEmpty, std::size_t before, bool flush = true);
 };
 #endif
\ No newline at end of file
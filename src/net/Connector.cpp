@@ -0,0 +1,217 @@
+/**
+ * @file Connector.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-08-20
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <random>
+
+#include "Connector.hpp"
+#include "EventLoop.hpp"
+
+Connector::Connector(std::shared_ptr<EventLoop> loop, const sockaddr *addr,
+                     socklen_t len)
+    : loop_(loop) {
+  local_sock_ = kInvaild_;
+  local_port_ = kInvalidPort_;
+  assert(len <= sizeof(addr_));
+  ::memset(&addr_, 0, sizeof(addr_));
+  ::memcpy(&addr_, addr, len);
+  addrLen_ = len;
+}
+
+Connector::~Connector() {
+  if (local_sock_ != kInvaild_)
+    ::close(local_sock_);
+}
+
+int Connector::Identifier() const { return local_sock_; }
+
+std::function<void()> Connector::_Guard(void (Connector::*fn)()) {
+  std::weak_ptr<Channel> weak = weak_from_this();
+  return [weak, fn]() {
+    if (auto self = weak.lock())
+      (static_cast<Connector *>(self.get())->*fn)();
+  };
+}
+
+void Connector::Start() {
+  loop_->RunInThisLoop([self = shared_from_this(), this]() {
+    if (state_ == ConnectState::Connecting || state_ == ConnectState::Retrying)
+      return;
+    retries_ = 0;
+    delay_ = initialDelay_;
+    _Connect();
+  });
+}
+
+void Connector::Stop() {
+  loop_->RunInThisLoop([self = shared_from_this(), this]() {
+    _Reset();
+    if (state_ != ConnectState::Connected)
+      state_ = ConnectState::None;
+  });
+}
+
+void Connector::_Connect() {
+  state_ = ConnectState::Connecting;
+  local_sock_ =
+      ::socket(addr_.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (local_sock_ < 0) {
+    local_sock_ = kInvaild_;
+    _Retry(errno); // fd 耗尽等, 稍后可能恢复
+    return;
+  }
+  ApplyConnectOptions(local_sock_, options_);
+  int ret = ::connect(local_sock_, (struct sockaddr *)&addr_, addrLen_);
+  const int error = ret == 0 ? 0 : errno;
+  switch (error) {
+  case 0:
+  case EINPROGRESS:
+  case EINTR:
+  case EISCONN:
+    // 立即连上也等可写事件, 统一在 HandleWriteEvent 中交出 fd
+    loop_->Register(EPOLL_ET_Write, shared_from_this());
+    if (timeout_.count() > 0)
+      timer_ = loop_->RunAfter(timeout_, _Guard(&Connector::_OnTimeout));
+    break;
+  case EAGAIN: // 本地端口耗尽, 或 Unix 域对端 backlog 已满
+  case ENOENT: // Unix 域路径尚不存在
+  case EADDRINUSE:
+  case EADDRNOTAVAIL:
+  case ECONNREFUSED:
+  case ENETUNREACH:
+  case EHOSTUNREACH:
+  case ETIMEDOUT:
+    _Retry(error);
+    break;
+  default: // EACCES, EAFNOSUPPORT 等, 重试也不会成功
+    printf("connect to %s error: %s\n",
+           AddressToString((const sockaddr *)&addr_, addrLen_).c_str(),
+           strerror(error));
+    _Reset();
+    _Fail();
+    break;
+  }
+}
+
+bool Connector::HandleWriteEvent() {
+  if (state_ != ConnectState::Connecting)
+    return true;
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (::getsockopt(local_sock_, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+    error = errno;
+  if (error == 0 && _IsSelfConnect())
+    error = ECONNREFUSED; // 对端端口落在本地临时端口范围内, 连上了自己
+  if (error != 0) {
+    _Retry(error);
+    return true;
+  }
+  if (timer_ != 0) {
+    loop_->Cancel(timer_);
+    timer_ = 0;
+  }
+  loop_->Unregister(EPOLL_ET_Write, this);
+  ApplyConnectionOptions(local_sock_, options_);
+  int connfd = local_sock_;
+  local_sock_ = kInvaild_;
+  state_ = ConnectState::Connected;
+  makeNewConnection(connfd, _Peer());
+  return true;
+}
+
+bool Connector::HandleReadEvent() { return true; }
+
+void Connector::HandleErrorEvent() {
+  if (state_ != ConnectState::Connecting)
+    return;
+  int error = 0;
+  socklen_t len = sizeof(error);
+  ::getsockopt(local_sock_, SOL_SOCKET, SO_ERROR, &error, &len);
+  _Retry(error != 0 ? error : ECONNREFUSED);
+}
+
+void Connector::_OnTimeout() {
+  timer_ = 0;
+  if (state_ == ConnectState::Connecting)
+    _Retry(ETIMEDOUT);
+}
+
+void Connector::_OnRetry() {
+  timer_ = 0;
+  if (state_ == ConnectState::Retrying)
+    _Connect();
+}
+
+void Connector::_Retry(int error) {
+  _Reset();
+  if (maxRetries_ >= 0 && retries_ >= maxRetries_) {
+    printf("connect to %s failed: %s\n",
+           AddressToString((const sockaddr *)&addr_, addrLen_).c_str(),
+           strerror(error));
+    _Fail();
+    return;
+  }
+  ++retries_;
+  // 在 [d/2, d] 中随机, 避免大量客户端同时重连
+  static thread_local std::minstd_rand rng(std::random_device{}());
+  const auto d = delay_.count();
+  const auto wait = std::max(
+      std::chrono::milliseconds(d / 2 + rng() % (d - d / 2 + 1)), kMinDelay_);
+  delay_ = std::min(delay_ * 2, maxDelay_);
+  state_ = ConnectState::Retrying;
+  timer_ = loop_->RunAfter(wait, _Guard(&Connector::_OnRetry));
+}
+
+void Connector::_Fail() {
+  state_ = ConnectState::Failed;
+  if (onFailed_)
+    onFailed_();
+}
+
+void Connector::_Reset() {
+  if (timer_ != 0) {
+    loop_->Cancel(timer_);
+    timer_ = 0;
+  }
+  if (local_sock_ == kInvaild_)
+    return;
+  loop_->Unregister(EPOLL_ET_Write, this);
+  ::close(local_sock_);
+  local_sock_ = kInvaild_;
+}
+
+sockaddr_in Connector::_Peer() const {
+  sockaddr_in peer;
+  ::memset(&peer, 0, sizeof(peer));
+  if (addr_.ss_family == AF_INET)
+    ::memcpy(&peer, &addr_, sizeof(peer));
+  else
+    peer.sin_family = addr_.ss_family;
+  return peer;
+}
+
+bool Connector::_IsSelfConnect() const {
+  if (addr_.ss_family != AF_INET)
+    return false;
+  sockaddr_in local{}, remote{};
+  socklen_t len = sizeof(local);
+  if (::getsockname(local_sock_, (sockaddr *)&local, &len) != 0)
+    return false;
+  len = sizeof(remote);
+  if (::getpeername(local_sock_, (sockaddr *)&remote, &len) != 0)
+    return false;
+  return local.sin_port == remote.sin_port &&
+         local.sin_addr.s_addr == remote.sin_addr.s_addr;
+}
@@ -8,40 +8,90 @@
  * @copyright Copyright (c) 2022
  *
  */
+#ifndef SNOWY_CONNECTOR_H
+#define SNOWY_CONNECTOR_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
 
 #include "Channel.hpp"
+#include "TimerQueue.hpp"
+
 enum class ConnectState {
   None,
-  Connecting,
+  Connecting, // 已发起非阻塞 connect, 等待可写
+  Retrying,   // 等待退避定时器
   Connected,
-  Failed,
+  Failed, // 重试次数用尽或 Stop
 };
 class EventLoop;
 
+/**
+ * @brief 非阻塞 connect 状态机
+ *
+ * connect 返回 EINPROGRESS 后关注可写事件，可写时以 SO_ERROR 判断结果。
+ * 超过 connect 超时或失败后按指数退避重试，每次延迟在 [d/2, d] 中随机，
+ * d 从 initial 翻倍到 max。连接成功后注销自己并把 fd 交给
+ * makeNewConnection，由其创建 Connection。
+ *
+ * Start / Stop 线程安全，其余接口需在 Start 之前调用。
+ */
 class Connector : public Channel {
   std::shared_ptr<EventLoop> loop_;
   int local_sock_;
   uint16_t local_port_;
-  sockaddr_in peer_;
-  ConnectState state_ = ConnectState::None;
+  sockaddr_storage addr_; // IPv4 或 Unix 域地址
+  socklen_t addrLen_;
+  std::atomic<ConnectState> state_{ConnectState::None};
 
   static const int kInvaild_ = -1;
   static const uint16_t kInvalidPort_ = -1;
   using MakeNewConnection =
       std::function<void(int connfd, const sockaddr_in &peer)>;
   MakeNewConnection makeNewConnection;
+  using FailedCallback = std::function<void()>;
+  FailedCallback onFailed_;
+
+  std::chrono::milliseconds timeout_{3000};
+  static constexpr std::chrono::milliseconds kMinDelay_{1};
+  std::chrono::milliseconds initialDelay_{100};
+  std::chrono::milliseconds maxDelay_{10000};
+  std::chrono::milliseconds delay_{0}; // 下一次重试的退避上限
+  int maxRetries_ = -1;                // 小于 0 表示一直重试
+  int retries_ = 0;
+  TimerId timer_ = 0; // 超时或退避定时器, 仅 loop 线程
+  SocketOptions options_;
 
 public:
-  explicit Connector(std::shared_ptr<EventLoop> loop) {
-    loop_ = loop;
-    local_sock_ = kInvaild_;
-    local_port_ = kInvalidPort_;
-  }
+  Connector(std::shared_ptr<EventLoop> loop, const sockaddr_in &peer)
+      : Connector(loop, (const sockaddr *)&peer, sizeof(peer)) {}
+  ///@brief addr 可以是 sockaddr_in 或 sockaddr_un (含抽象命名空间)
+  Connector(std::shared_ptr<EventLoop> loop, const sockaddr *addr,
+            socklen_t len);
+  ~Connector();
   Connector(const Connector &) = delete;
   void operator=(const Connector &) = delete;
 
+  void Start();
+  void Stop();
+  ConnectState State() const { return state_; }
+  ///@brief 单次 connect 的超时, 0 表示不限
+  void SetTimeout(std::chrono::milliseconds timeout) { timeout_ = timeout; }
+  ///@brief 退避的初始与最大间隔, 不小于 kMinDelay_ 以免重连空转
+  void SetBackoff(std::chrono::milliseconds initial,
+                  std::chrono::milliseconds max) {
+    initialDelay_ = std::max(initial, kMinDelay_);
+    maxDelay_ = std::max(max, initialDelay_);
+  }
+  ///@brief 首次失败后最多重试的次数, 小于 0 表示一直重试
+  void SetMaxRetries(int retries) { maxRetries_ = retries; }
+  ///@brief connect 前与连接建立后应用, 见 SocketOptions
+  void SetSocketOptions(const SocketOptions &options) { options_ = options; }
+  ///@brief 重试次数用尽时在 loop 线程调用
+  void SetFailedCallback(FailedCallback cb) { onFailed_ = std::move(cb); }
+
 public:
   int Identifier() const override;
   bool HandleReadEvent() override;
@@ -50,4 +100,21 @@ public:
   void setMakeNewConnection(MakeNewConnection func) {
     makeNewConnection = func;
   }
-};
\ No newline at end of file
+
+private:
+  void _Connect();
+  void _OnTimeout();
+  void _OnRetry();
+  ///@brief 关闭当前 socket, 按退避延迟安排下一次 connect
+  void _Retry(int error);
+  void _Fail();
+  ///@brief 注销并关闭当前 socket, 取消定时器
+  void _Reset();
+  bool _IsSelfConnect() const;
+  ///@brief 交给 makeNewConnection 的对端地址, Unix 域只保留地址族
+  sockaddr_in _Peer() const;
+  ///@brief 包装成定时器回调, 到期时 Connector 已销毁则不执行
+  std::function<void()> _Guard(void (Connector::*fn)());
+};
+
+#endif
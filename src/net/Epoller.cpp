@@ -13,58 +13,71 @@ Epoller::~Epoller() {
   };
 }
 
-bool Epoller::Register(int epfd, int events, void *userPtr) {
+static epoll_event _ToEpollEvent(int events, void *userPtr) {
   epoll_event ev{0};
   ev.data.ptr = userPtr;
-  if (events & EPOLL_ET_Read) {
+  if (events & EPOLL_ET_Read)
     ev.events |= EPOLLIN;
-    ev.events |= EPOLLET;
-  }
-
   if (events & EPOLL_ET_Write)
     ev.events |= EPOLLOUT;
+  if (!(events & EPOLL_ET_Level))
+    ev.events |= EPOLLET;
+  return ev;
+}
 
-  return 0 == epoll_ctl(multiplexer_, EPOLL_CTL_ADD, epfd, &ev);
+bool Epoller::Register(int epfd, int events, void *userPtr) {
+  if (IsRegistered(epfd))
+    return false;
+  epoll_event ev = _ToEpollEvent(events, userPtr);
+  ++ctlCount_;
+  if (0 != epoll_ctl(multiplexer_, EPOLL_CTL_ADD, epfd, &ev))
+    return false;
+  _SetInterest(epfd, events);
+  return true;
 }
 
 bool Epoller::Modify(int epfd, int events, void *userPtr) {
-  epoll_event ev{0};
-  ev.data.ptr = userPtr;
-  if (events & EPOLL_ET_Read)
-    ev.events |= EPOLLIN;
-  if (events & EPOLL_ET_Write)
-    ev.events |= EPOLLOUT;
-
-  return 0 == epoll_ctl(multiplexer_, EPOLL_CTL_MOD, epfd, &ev);
+  if (!IsRegistered(epfd))
+    return false;
+  events = _MergeMode(epfd, events);
+  if (Interest(epfd) == events)
+    return true; // 兴趣未变, 省掉一次 epoll_ctl
+  epoll_event ev = _ToEpollEvent(events, userPtr);
+  ++ctlCount_;
+  if (0 != epoll_ctl(multiplexer_, EPOLL_CTL_MOD, epfd, &ev))
+    return false;
+  _SetInterest(epfd, events);
+  return true;
 }
+
 bool Epoller::Unregister(int epfd, int events) {
   epoll_event dummy;
+  _ClearInterest(epfd);
+  ++ctlCount_;
   return 0 == epoll_ctl(multiplexer_, EPOLL_CTL_DEL, epfd, &dummy);
 }
 
-int Epoller::Poll(std::size_t maxEvent, int timeoutMs) {
-  if (maxEvent == 0)
-    return 0;
-  while (events_.size() < maxEvent)
-    events_.resize(2 * events_.size() + 1);
+int Epoller::Poll(int timeoutMs, FiredCallback cb, void *ctx) {
+  if (events_.size() < batch_)
+    events_.resize(batch_);
+  const int maxEvent = static_cast<int>(batch_);
   int nFired = ::epoll_wait(multiplexer_, &events_[0], maxEvent, timeoutMs);
-  if (nFired == -1 && errno != EINTR && errno != EWOULDBLOCK)
-    return -1;
-  //  received events set channel
-  if (nFired > 0)
-    firedEvents_.resize(nFired);
+  if (nFired == -1)
+    return errno == EINTR ? 0 : -1;
   for (int i = 0; i < nFired; ++i) {
-    FiredEvent &fired = firedEvents_[i];
-    fired.events = 0;
-    fired.userdata = events_[i].data.ptr;
-    if (events_[i].events & EPOLLIN)
-      fired.events |= EPOLL_ET_Read;
-
-    if (events_[i].events & EPOLLOUT)
-      fired.events |= EPOLL_ET_Write;
-
-    if (events_[i].events & (EPOLLERR | EPOLLHUP))
-      fired.events |= EPOLL_ET_ERROR;
+    const uint32_t ev = events_[i].events;
+    int events = 0;
+    if (ev & EPOLLIN)
+      events |= EPOLL_ET_Read;
+    if (ev & EPOLLOUT)
+      events |= EPOLL_ET_Write;
+    if (ev & EPOLLERR)
+      events |= EPOLL_ET_ErrQueue;
+    if (ev & EPOLLHUP)
+      events |= EPOLL_ET_ERROR;
+    cb(ctx, events_[i].data.ptr, events);
   }
+  if (nFired == maxEvent)
+    _GrowBatch();
   return nFired;
 }
@@ -1,17 +1,38 @@
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 
 #include "EventLoop.hpp"
+#include "IoUringPoller.hpp"
 
 static thread_local EventLoop *g_thisLoop = nullptr;
 
-EventLoop::EventLoop() : poller_(new Epoller) {
+static Poller *_CreatePoller(PollerType type) {
+  if (type == PollerType::IoUring) {
+    auto uring = new IoUringPoller();
+    if (uring->Valid())
+      return uring;
+    delete uring;
+    printf("io_uring unavailable, fall back to epoll\n");
+  }
+  return new Epoller;
+}
+
+EventLoop::EventLoop(PollerType type) : poller_(_CreatePoller(type)) {
   assert(!g_thisLoop && "There must be only one EventLoop per thread");
   g_thisLoop = this;
   running_ = true;
-  notifier_ = std::make_shared<PipeChannel>();
+  notifier_ = std::make_shared<EventfdChannel>();
+  timers_ = std::make_shared<TimerQueue>(this);
+}
+EventLoop::~EventLoop() {
+  if (g_thisLoop == this)
+    g_thisLoop = nullptr; // 允许同一线程先后创建多个 loop
+  while (auto node = pendingFunctors_.Pop())
+    delete node;
 }
-EventLoop::~EventLoop() {}
 bool EventLoop::IsRunningThisLoop() const { return this == g_thisLoop; }
 void EventLoop::RunInThisLoop(Functor cb) {
   if (IsRunningThisLoop()) {
@@ -21,90 +42,302 @@ void EventLoop::RunInThisLoop(Functor cb) {
   }
 }
 
+void EventLoop::Stop() {
+  running_ = false;
+  if (!IsRunningThisLoop())
+    notifier_->Notify();
+}
+
+TimerId EventLoop::RunAt(TimerQueue::TimePoint when, Functor cb) {
+  return timers_->RunAt(when, TimerQueue::Duration::zero(), std::move(cb));
+}
+
+TimerId EventLoop::RunAfter(TimerQueue::Duration delay, Functor cb) {
+  return RunAt(TimerQueue::Clock::now() + delay, std::move(cb));
+}
+
+TimerId EventLoop::RunEvery(TimerQueue::Duration interval, Functor cb) {
+  assert(interval > TimerQueue::Duration::zero());
+  return timers_->RunAt(TimerQueue::Clock::now() + interval, interval,
+                        std::move(cb));
+}
+
+void EventLoop::Cancel(TimerId id) { timers_->Cancel(id); }
+
 void EventLoop::_QueueInThisLoop(Functor cb) {
-  {
-    std::lock_guard<std::mutex> lock(funcMutex_);
-    pendingFunctors_.emplace_back(std::move(cb));
-  }
+  pendingFunctors_.Push(new PendingFunctor(std::move(cb)));
   if (!IsRunningThisLoop() || callingPendingFunctors_) {
     notifier_->Notify();
   }
 }
 
 bool EventLoop::Register(int events, std::shared_ptr<Channel> src) {
-  if (poller_->Register(src->Identifier(), events, src.get())) {
-    return channelSet_.insert(src).second;
-  }
-  return false;
+  assert(IsRunningThisLoop());
+  const int fd = src->Identifier();
+  if (fd < 0)
+    return false;
+  if (static_cast<std::size_t>(fd) >= channels_.size())
+    channels_.resize(std::max<std::size_t>(fd + 1, 2 * channels_.size()));
+  ChannelSlot &slot = channels_[fd];
+  if (slot.channel || !poller_->Register(fd, events, src.get()))
+    return false;
+  slot.channel = std::move(src);
+  slot.events = events;
+  ++channelCount_;
+  return true;
 }
-bool EventLoop::Modify(int events, std::shared_ptr<Channel> src) {
-  assert(channelSet_.find(src) != channelSet_.end());
-  return poller_->Modify(src->Identifier(), events, src.get());
+
+bool EventLoop::Modify(int events, Channel *src) {
+  assert(IsRunningThisLoop());
+  ChannelSlot *slot = _Slot(src->Identifier());
+  assert(slot && slot->channel.get() == src);
+  if (slot->events == events)
+    return true; // 兴趣未变, 不进入 poller
+  if (!poller_->Modify(src->Identifier(), events, src))
+    return false;
+  slot->events = events;
+  return true;
 }
 
-void EventLoop::Unregister(int events, std::shared_ptr<Channel> src) {
+void EventLoop::Unregister(int events, Channel *src) {
+  assert(IsRunningThisLoop());
+  ChannelSlot *slot = _Slot(src->Identifier());
+  if (!slot || slot->channel.get() != src)
+    return;
   poller_->Unregister(src->Identifier(), events);
-  channelSet_.erase(src);
+  // 可能正处于 src 的 handler 中, 延迟到本轮结束再释放
+  pendingRelease_.push_back(std::move(slot->channel));
+  slot->events = EPOLL_ET_None;
+  --channelCount_;
+}
+
+void EventLoop::ForEachChannel(const std::function<void(Channel *)> &cb) {
+  assert(IsRunningThisLoop());
+  for (std::size_t fd = 0; fd < channels_.size(); ++fd) {
+    if (channels_[fd].channel)
+      cb(channels_[fd].channel.get());
+  }
 }
 
 void EventLoop::Run() {
-  const std::chrono::milliseconds defaultPollTime(10);
+  // 定时由 timerfd 唤醒, 跨线程任务由 notifier_ 唤醒, 无需超时轮询
+  const std::chrono::milliseconds pollForever(-1);
   Register(EPOLL_ET_Read, notifier_);
+  Register(EPOLL_ET_Read, timers_);
   while (running_) {
-    _Loop(defaultPollTime);
+    if (spinBudget_.count() > 0)
+      _Spin();
+    if (!running_)
+      break;
+    const auto blockBegin = TimerQueue::Clock::now();
+    const int ready = _Loop(pollForever);
+    if (ready > 0 && busyPollBudget_.count() > 0)
+      _AdjustSpin(TimerQueue::Clock::now() - blockBegin);
   }
-  for (auto &kv : channelSet_) {
-    poller_->Unregister(kv->Identifier(), EPOLL_ET_Read | EPOLL_ET_Write);
+  for (std::size_t fd = 0; fd < channels_.size(); ++fd) {
+    if (channels_[fd].channel)
+      poller_->Unregister(static_cast<int>(fd), EPOLL_ET_Read | EPOLL_ET_Write);
   }
-  channelSet_.clear();
+  channels_.clear();
+  channelCount_ = 0;
+  pendingRelease_.clear();
   poller_.reset();
 }
 
-bool EventLoop::_Loop(std::chrono::milliseconds timeout) {
-  if (channelSet_.empty()) {
-    std::this_thread::sleep_for(timeout);
-    return false;
+void EventLoop::SetBusyPoll(std::chrono::microseconds budget,
+                            int socketBusyPollUs) {
+  busyPollBudget_ = budget;
+  spinBudget_ = budget;
+  socketBusyPollUs_ = socketBusyPollUs;
+}
+
+void EventLoop::_Spin() {
+  const std::chrono::milliseconds noWait(0);
+  auto deadline = TimerQueue::Clock::now() + spinBudget_;
+  bool worked = false;
+  while (running_) {
+    if (_Loop(noWait) > 0) {
+      worked = true;
+      deadline = TimerQueue::Clock::now() + spinBudget_;
+    } else if (TimerQueue::Clock::now() >= deadline) {
+      break;
+    }
+  }
+  // 整轮自旋都没有事件, 预算减半, 过小则关闭自旋直到再次被唤醒
+  if (!worked) {
+    spinBudget_ /= 2;
+    if (spinBudget_ < busyPollBudget_ / 16)
+      spinBudget_ = std::chrono::nanoseconds::zero();
+  }
+}
+
+void EventLoop::_AdjustSpin(TimerQueue::Duration blocked) {
+  const auto minSpin = busyPollBudget_ / 16;
+  if (blocked < 4 * busyPollBudget_) {
+    // 停止自旋后很快就有事件, 多自旋一会儿就能接住, 逐步恢复预算
+    spinBudget_ = spinBudget_.count() == 0
+                      ? minSpin
+                      : std::min(spinBudget_ * 2, busyPollBudget_);
+  } else {
+    // 事件稀疏, 自旋只会空转, 继续退避
+    spinBudget_ /= 2;
+    if (spinBudget_ < minSpin)
+      spinBudget_ = std::chrono::nanoseconds::zero();
   }
-  // TODO: process poller_
-  const int ready = poller_->Poll(static_cast<int>(channelSet_.size()),
-                                  static_cast<int>(timeout.count()));
+}
+
+static uint64_t _Ns(TimerQueue::Duration d) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+static void _Increase(std::atomic<uint64_t> &a, uint64_t v) {
+  a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+int EventLoop::_Loop(std::chrono::milliseconds timeout) {
+  // Run 中 notifier_ 与 timers_ 总是已注册, 表不会为空
+  const auto pollBegin = TimerQueue::Clock::now();
+  firstFired_ = TimerQueue::TimePoint();
+  const int ready = poller_->Poll(static_cast<int>(timeout.count()),
+                                  &EventLoop::_OnFired, this);
   if (ready < 0) {
-    return false;
+    // Poller 已处理 EINTR 等可重试的错误, 这里的错误每次都会重现
+    printf("poll failed: %s, stop loop\n", strerror(errno));
+    running_ = false;
+    return -1;
   }
-  const auto &fired = poller_->GetFiredEvents();
-  for (int i = 0; i < ready; ++i) {
-    assert(fired[i].userdata != nullptr);
-    auto src = static_cast<Channel *>(fired[i].userdata);
-    if (fired[i].events & EPOLL_ET_Read) {
-      if (!src->HandleReadEvent()) {
-        src->HandleErrorEvent();
-      }
+  const auto pollEnd = TimerQueue::Clock::now();
+  pendingRelease_.clear();
+
+  const std::size_t functors = _DoPendingFunctors();
+  const auto end = TimerQueue::Clock::now();
+  // handler 在 Poll 内直接分发, 阻塞时间只算到第一个事件开始处理
+  const auto wakeup =
+      firstFired_ == TimerQueue::TimePoint() ? pollEnd : firstFired_;
+  _UpdateLoad(wakeup - pollBegin, end - wakeup);
+
+  if (ready == 0 && functors == 0) {
+    _Increase(metrics_.emptyPolls, 1);
+    return ready;
+  }
+  metrics_.iterationNs.Record(_Ns(end - wakeup));
+  metrics_.pollNs.Record(_Ns(wakeup - pollBegin));
+  metrics_.eventsPerPoll.Record(ready);
+  if (functors > 0) {
+    _Increase(metrics_.functors, functors);
+    metrics_.functorNs.Record(_Ns(end - pollEnd));
+  }
+  return ready;
+}
+
+void EventLoop::_OnFired(void *ctx, void *userPtr, int events) {
+  assert(userPtr != nullptr);
+  auto loop = static_cast<EventLoop *>(ctx);
+  auto src = static_cast<Channel *>(userPtr);
+  if (loop->firstFired_ == TimerQueue::TimePoint()) {
+    loop->firstFired_ = TimerQueue::Clock::now();
+    loop->handlerMark_ = loop->firstFired_;
+  }
+  // 每个 handler 之后都可能已注销 (自己或同批的其他 channel)
+  if ((events & EPOLL_ET_Read) && loop->_IsActive(src)) {
+    if (!src->HandleReadEvent()) {
+      src->HandleErrorEvent();
     }
+  }
 
-    if (fired[i].events & EPOLL_ET_Write) {
-      if (!src->HandleWriteEvent()) {
-        src->HandleErrorEvent();
-      }
+  if ((events & EPOLL_ET_Write) && loop->_IsActive(src)) {
+    if (!src->HandleWriteEvent()) {
+      src->HandleErrorEvent();
     }
+  }
 
-    if (fired[i].events & EPOLL_ET_ERROR) {
-      std::cout << "EPOLL_ET_ERROR" << std::endl;
+  if ((events & EPOLL_ET_ErrQueue) && loop->_IsActive(src)) {
+    if (!src->HandleErrQueueEvent()) {
       src->HandleErrorEvent();
     }
   }
 
-  // TODO: process function TRY try_lock
-  if (pendingFunctors_.size() == 0)
-    return true;
-  std::vector<Functor> functors;
-  callingPendingFunctors_ = true;
-  {
-    std::lock_guard<std::mutex> guard(funcMutex_);
-    functors.swap(pendingFunctors_);
+  if ((events & EPOLL_ET_ERROR) && loop->_IsActive(src)) {
+    std::cout << "EPOLL_ET_ERROR" << std::endl;
+    src->HandleErrorEvent();
   }
-  for (const Functor &functor : functors) {
-    functor();
+
+  // 相邻 handler 首尾相接, 每个事件只读一次时钟
+  const auto now = TimerQueue::Clock::now();
+  loop->metrics_.handlerNs.Record(_Ns(now - loop->handlerMark_));
+  loop->handlerMark_ = now;
+}
+
+void EventLoop::_UpdateLoad(TimerQueue::Duration idle,
+                            TimerQueue::Duration busy) {
+  using namespace std::chrono;
+  busyNs_.fetch_add(duration_cast<nanoseconds>(busy).count(),
+                    std::memory_order_relaxed);
+  windowBusy_ += busy;
+  windowTotal_ += idle + busy;
+  // 至少累计 10ms 再计算一次, 避免每轮都写共享变量
+  if (windowTotal_ < milliseconds(10))
+    return;
+  uint32_t ratio = static_cast<uint32_t>(1000 * windowBusy_ / windowTotal_);
+  uint32_t old = busyPermille_.load(std::memory_order_relaxed);
+  busyPermille_.store((old + ratio) / 2, std::memory_order_relaxed);
+  loadUpdatedNs_.store(
+      duration_cast<nanoseconds>(
+          TimerQueue::Clock::now().time_since_epoch())
+          .count(),
+      std::memory_order_relaxed);
+  windowBusy_ = windowTotal_ = TimerQueue::Duration::zero();
+}
+
+std::size_t EventLoop::ConnectionCount() const {
+  int64_t n = connections_.load(std::memory_order_relaxed) +
+              placing_.load(std::memory_order_relaxed);
+  return n > 0 ? static_cast<std::size_t>(n) : 0;
+}
+
+double EventLoop::BusyRatio() const {
+  using namespace std::chrono;
+  int64_t now = duration_cast<nanoseconds>(
+                    TimerQueue::Clock::now().time_since_epoch())
+                    .count();
+  // 长时间没有更新说明 loop 一直阻塞在 Poll 中, 即空闲
+  if (now - loadUpdatedNs_.load(std::memory_order_relaxed) >
+      duration_cast<nanoseconds>(seconds(1)).count())
+    return 0.0;
+  return busyPermille_.load(std::memory_order_relaxed) / 1000.0;
+}
+
+LoopLoad EventLoop::Load() const {
+  return LoopLoad{ConnectionCount(), BusyRatio(),
+                  busyNs_.load(std::memory_order_relaxed)};
+}
+
+LoopMetrics EventLoop::Metrics() const {
+  LoopMetrics m;
+  m.emptyPolls = metrics_.emptyPolls.load(std::memory_order_relaxed);
+  m.functors = metrics_.functors.load(std::memory_order_relaxed);
+  m.iterationNs = metrics_.iterationNs.Snapshot();
+  m.pollNs = metrics_.pollNs.Snapshot();
+  m.eventsPerPoll = metrics_.eventsPerPoll.Snapshot();
+  m.handlerNs = metrics_.handlerNs.Snapshot();
+  m.functorNs = metrics_.functorNs.Snapshot();
+  return m;
+}
+
+std::size_t EventLoop::_DoPendingFunctors() {
+  if (pendingFunctors_.Empty())
+    return 0;
+  // 先摘下当前可见的一批再执行, 执行期间新投递的任务留到下一轮,
+  // 由 callingPendingFunctors_ 保证其会唤醒 loop
+  callingPendingFunctors_ = true;
+  while (auto node = pendingFunctors_.Pop())
+    pendingBatch_.push_back(node);
+  for (PendingFunctor *node : pendingBatch_) {
+    node->fn();
+    delete node;
   }
+  const std::size_t count = pendingBatch_.size();
+  pendingBatch_.clear();
   callingPendingFunctors_ = false;
-  return true;
+  return count;
 }
\ No newline at end of file
@@ -13,8 +13,11 @@
 #define SNOWY_EVENTLOOP_H
 
 #include "Channel.hpp"
-#include "PipeChannel.hpp"
+#include "EventfdChannel.hpp"
+#include "Histogram.hpp"
+#include "MpscQueue.hpp"
 #include "Poller.hpp"
+#include "TimerQueue.hpp"
 
 #include <atomic>
 #include <memory>
@@ -24,16 +27,53 @@
 #include <chrono>
 #include <functional>
 
-#include <set>
 #include <vector>
 
+enum class PollerType {
+  Epoll,
+  IoUring, // 内核不支持时自动回退到 Epoll
+};
+
+///@brief loop 负载快照
+struct LoopLoad {
+  std::size_t connections; // 存活及正在建立的连接数
+  double busyRatio;        // 最近 Poll 之外时间占比的 EWMA, 0~1
+  uint64_t busyNs;         // 累计 Poll 之外的时间
+};
+
+/**
+ * @brief loop 运行指标快照, 时间单位均为纳秒
+ *
+ * 只统计处理了事件或任务的轮次，零超时 Poll 空转只计入 emptyPolls。
+ * 一轮的墙钟时间 = pollNs (阻塞) + iterationNs (处理)。
+ */
+struct LoopMetrics {
+  uint64_t emptyPolls = 0;
+  uint64_t functors = 0;           // 执行的跨线程任务数
+  HistogramSnapshot iterationNs;   // 每轮 Poll 唤醒后到处理完任务的时间
+  HistogramSnapshot pollNs;        // 每轮阻塞在 Poll 中的时间
+  HistogramSnapshot eventsPerPoll; // 每轮的就绪事件数, sum 为事件总数
+  HistogramSnapshot handlerNs;     // 每个就绪 channel 的处理时间, max 即最慢
+  HistogramSnapshot functorNs;     // 每轮执行任务的总时间, sum 为累计时间
+
+  void Merge(const LoopMetrics &other) {
+    emptyPolls += other.emptyPolls;
+    functors += other.functors;
+    iterationNs.Merge(other.iterationNs);
+    pollNs.Merge(other.pollNs);
+    eventsPerPoll.Merge(other.eventsPerPoll);
+    handlerNs.Merge(other.handlerNs);
+    functorNs.Merge(other.functorNs);
+  }
+};
+
 class EventLoop : public std::enable_shared_from_this<EventLoop> {
 private:
-  bool running_;
+  std::atomic<bool> running_;
   std::unique_ptr<Poller> poller_;
 
 public:
-  EventLoop();
+  explicit EventLoop(PollerType type = PollerType::Epoll);
   ~EventLoop();
   EventLoop(const EventLoop &) = delete;
   void operator=(const EventLoop &) = delete;
@@ -43,30 +83,148 @@ public:
 public:
   using Functor = std::function<void()>; //
 
-  using ChannelList = std::vector<std::unique_ptr<Channel>>;
-  using ChannelSet = std::set<std::shared_ptr<Channel>>;
-
   void Run();
+  ///@brief 线程安全，loop 处理完当前一轮事件后退出 Run()
+  void Stop();
+  /**
+   * @brief 忙轮询: 处理完事件后先以零超时 Poll 自旋至多 budget，再阻塞等待
+   *
+   * 自旋期间有新事件则继续自旋；一轮自旋没有任何事件时预算减半直至为 0，
+   * 阻塞等待被事件唤醒后再逐步翻倍恢复，空闲时不会持续占用 CPU。
+   * socketBusyPollUs 大于 0 时对本 loop 的连接设置 SO_BUSY_POLL。
+   * 需在 Run 之前或 loop 线程中调用，budget 为 0 表示关闭。
+   */
+  void SetBusyPoll(std::chrono::microseconds budget, int socketBusyPollUs = 0);
+  int SocketBusyPollUs() const { return socketBusyPollUs_; }
+  ///@brief 每次 Poll 的事件批大小, 积压时自动翻倍至 max, 需在 Run 之前调用
+  void SetEventBatch(std::size_t initial, std::size_t max) {
+    poller_->SetEventBatch(initial, max);
+  }
+  ///@brief 当前自适应的自旋预算
+  std::chrono::nanoseconds SpinBudget() const { return spinBudget_; }
   bool IsRunningThisLoop() const;
   void RunInThisLoop(Functor cb);
 
 public:
+  // 定时器, 均线程安全, 回调在本 loop 线程执行
+  TimerId RunAt(TimerQueue::TimePoint when, Functor cb);
+  TimerId RunAfter(TimerQueue::Duration delay, Functor cb);
+  TimerId RunEvery(TimerQueue::Duration interval, Functor cb);
+  void Cancel(TimerId id);
+
+public:
+  ///@brief 只能在 loop 线程调用, loop 的 channel 表持有 src, 直到 Unregister
   bool Register(int events, std::shared_ptr<Channel> src);
-  bool Modify(int events, std::shared_ptr<Channel> src);
-  void Unregister(int events, std::shared_ptr<Channel> src);
+  ///@brief 同下方裸指针版本, 只能在 loop 线程调用
+  bool Modify(int events, const std::shared_ptr<Channel> &src) {
+    return Modify(events, src.get());
+  }
+  void Unregister(int events, const std::shared_ptr<Channel> &src) {
+    Unregister(events, src.get());
+  }
+  /**
+   * @brief 只能在 loop 线程调用, 按 fd 查表, 不产生引用计数操作
+   *
+   * Unregister 后 channel 的引用延迟到本轮事件处理完才释放，handler
+   * 中注销自己是安全的；已注销的 channel 不会再收到本轮剩余的事件。
+   */
+  bool Modify(int events, Channel *src);
+  void Unregister(int events, Channel *src);
+  // 跨线程请用 RunInThisLoop 投递
+  ///@brief 只能在 loop 线程调用, 遍历当前注册的 channel, cb 中可注销 channel
+  void ForEachChannel(const std::function<void(Channel *)> &cb);
+  ///@brief 只能在 loop 线程调用
+  bool IsRegistered(Channel *src) { return _IsActive(src); }
+  ///@brief poller 实际发起的兴趣变更系统调用次数, 用于统计每请求开销
+  uint64_t CtlCount() const { return poller_ ? poller_->CtlCount() : 0; }
+
+public:
+  // 负载统计, 任意线程可读
+  std::size_t ConnectionCount() const;
+  double BusyRatio() const;
+  LoopLoad Load() const;
+  ///@brief 不停止 loop 取得指标快照, 各项之间可能相差正在进行的一轮
+  LoopMetrics Metrics() const;
+  ///@brief Connection 建立/析构时调用
+  void AddConnection() { connections_.fetch_add(1, std::memory_order_relaxed); }
+  void RemoveConnection() {
+    connections_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  ///@brief 连接已分配到本 loop 但尚未在 loop 线程中建立, 供分配策略参考
+  void AddPlacing() { placing_.fetch_add(1, std::memory_order_relaxed); }
+  void RemovePlacing() { placing_.fetch_sub(1, std::memory_order_relaxed); }
 
 private:
-  bool _Loop(std::chrono::milliseconds timeout);
+  ///@return 本轮处理的事件数, 出错返回 -1
+  int _Loop(std::chrono::milliseconds timeout);
+  ///@brief Poller 的回调, 把就绪事件分发给 channel
+  static void _OnFired(void *ctx, void *userPtr, int events);
+  ///@brief 自旋直到预算内没有新事件, 并按结果调整预算
+  void _Spin();
+  ///@brief 阻塞 blocked 后被事件唤醒, 据此增减自旋预算
+  void _AdjustSpin(TimerQueue::Duration blocked);
   void _QueueInThisLoop(Functor cb);
   void _WakeUp();
-  std::vector<Functor> pendingFunctors_;
+  ///@return 执行的任务数
+  std::size_t _DoPendingFunctors();
+  void _UpdateLoad(TimerQueue::Duration idle, TimerQueue::Duration busy);
+
+  struct PendingFunctor : public MpscNode {
+    explicit PendingFunctor(Functor f) : fn(std::move(f)) {}
+    Functor fn;
+  };
+  MpscQueue<PendingFunctor> pendingFunctors_;
+  std::vector<PendingFunctor *> pendingBatch_; // 复用, 避免每轮分配
   std::atomic<bool> callingPendingFunctors_; /* atomic */
-  std::mutex funcMutex_;
-  int wakeupFd_; // just for help wakeup
-  std::shared_ptr<PipeChannel> notifier_;
+  std::shared_ptr<EventfdChannel> notifier_;
+  std::shared_ptr<TimerQueue> timers_;
+
+  std::chrono::nanoseconds busyPollBudget_{0}; // 自旋预算上限
+  std::chrono::nanoseconds spinBudget_{0};     // 当前预算, 仅 loop 线程
+  int socketBusyPollUs_ = 0;
+
+  ///@brief 以 fd 为下标的 channel 表, 持有 channel 并记录注册的事件
+  struct ChannelSlot {
+    std::shared_ptr<Channel> channel;
+    int events = EPOLL_ET_None;
+  };
+  ChannelSlot *_Slot(int fd) {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= channels_.size())
+      return nullptr;
+    return &channels_[fd];
+  }
+  ///@brief src 仍在表中才分发事件
+  bool _IsActive(Channel *src) {
+    ChannelSlot *slot = _Slot(src->Identifier());
+    return slot && slot->channel.get() == src;
+  }
+  std::vector<ChannelSlot> channels_; // 仅 loop 线程访问
+  std::size_t channelCount_ = 0;
+  // 本轮注销的 channel, 事件处理完后释放
+  std::vector<std::shared_ptr<Channel>> pendingRelease_;
+
+  std::atomic<int64_t> connections_{0};
+  std::atomic<int64_t> placing_{0};
+  std::atomic<uint64_t> busyNs_{0};
+  std::atomic<uint32_t> busyPermille_{0}; // EWMA, 千分比
+  std::atomic<int64_t> loadUpdatedNs_{0}; // steady_clock, 上次更新时间
+  TimerQueue::Duration windowBusy_{0};    // 当前统计窗口, 仅 loop 线程
+  TimerQueue::Duration windowTotal_{0};
+  // 本轮首个就绪事件开始处理的时间, 仅 loop 线程
+  TimerQueue::TimePoint firstFired_;
 
-  ChannelList activeChannels_; // activeChannels_ process
-  ChannelSet channelSet_;
+  // 运行指标, 仅 loop 线程写
+  struct MetricsRecorder {
+    std::atomic<uint64_t> emptyPolls{0};
+    std::atomic<uint64_t> functors{0};
+    Histogram iterationNs;
+    Histogram pollNs;
+    Histogram eventsPerPoll;
+    Histogram handlerNs;
+    Histogram functorNs;
+  };
+  MetricsRecorder metrics_;
+  TimerQueue::TimePoint handlerMark_; // 上一个 handler 结束的时间
 };
 
 #endif /* SNOWY_EVENTLOOP_H */
\ No newline at end of file
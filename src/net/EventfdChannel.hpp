@@ -0,0 +1,66 @@
+/**
+ * @file EventfdChannel.hpp
+ * @author JDongChen
+ * @brief 基于 eventfd 的 loop 唤醒通道
+ * @version 0.1
+ * @date 2022-08-28
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_EVENTFDCHANNEL_H
+#define SNOWY_EVENTFDCHANNEL_H
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+
+#include "Channel.hpp"
+
+/**
+ * @brief 合并多次通知的唤醒通道
+ *
+ * pending_ 为 true 时说明已经有一次唤醒尚未被 loop 消费，后续 Notify
+ * 直接返回，不再进入内核。HandleReadEvent 先清除 pending_ 再读空计数器，
+ * 因此在清除之后入队的任务一定会再触发一次写入，不会丢失唤醒。
+ */
+class EventfdChannel : public Channel {
+public:
+  EventfdChannel() : pending_(false) {
+    fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(fd_ >= 0);
+  }
+  ~EventfdChannel() { ::close(fd_); }
+
+  EventfdChannel(const EventfdChannel &) = delete;
+  void operator=(const EventfdChannel &) = delete;
+
+  int Identifier() const override { return fd_; }
+  bool HandleReadEvent() override {
+    pending_.exchange(false); // RMW, 与生产者的 exchange 同步
+    uint64_t count;
+    // 计数器一次读出并清零
+    auto n = ::read(fd_, &count, sizeof(count));
+    return n == sizeof(count) || errno == EAGAIN;
+  }
+  bool HandleWriteEvent() override {
+    assert(false);
+    return false;
+  }
+  void HandleErrorEvent() override {}
+
+  bool Notify() {
+    if (pending_.exchange(true))
+      return true; // 已有未消费的唤醒
+    uint64_t one = 1;
+    auto n = ::write(fd_, &one, sizeof(one));
+    return n == sizeof(one);
+  }
+
+private:
+  int fd_;
+  std::atomic<bool> pending_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file Handoff.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-09-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "Handoff.hpp"
+#include "Socket.hpp"
+
+int HandoffListen(const std::string &path) {
+  sockaddr_un addr;
+  socklen_t len;
+  if (!FillUnixAddress(path, &addr, &len))
+    return -1;
+  int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0)
+    return -1;
+  if (path[0] != '@')
+    ::unlink(path.c_str());
+  if (::bind(sock, (sockaddr *)&addr, len) != 0 || ::listen(sock, 1) != 0) {
+    printf("handoff listen on %s failed: %s\n", path.c_str(), strerror(errno));
+    ::close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+int HandoffConnect(const std::string &path) {
+  sockaddr_un addr;
+  socklen_t len;
+  if (!FillUnixAddress(path, &addr, &len))
+    return -1;
+  int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0)
+    return -1;
+  if (::connect(sock, (sockaddr *)&addr, len) != 0) {
+    ::close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+bool HandoffSend(int sock, HandoffMsg type, const int *fds,
+                 std::size_t fdCount, const sockaddr_in *peer,
+                 const void *payload, std::size_t len) {
+  if (fdCount > kHandoffMaxFds || len > kHandoffMaxPayload)
+    return false;
+  HandoffHeader header;
+  ::memset(&header, 0, sizeof(header));
+  header.type = static_cast<uint32_t>(type);
+  header.fdCount = static_cast<uint32_t>(fdCount);
+  header.payloadLen = static_cast<uint32_t>(len);
+  if (peer)
+    header.peer = *peer;
+
+  iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = const_cast<void *>(payload);
+  iov[1].iov_len = len;
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kHandoffMaxFds)];
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = len > 0 ? 2 : 1;
+  if (fdCount > 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fdCount);
+    cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * fdCount);
+    ::memcpy(CMSG_DATA(cm), fds, sizeof(int) * fdCount);
+  }
+  // SOCK_SEQPACKET 整条消息要么发送成功要么失败, 不会部分写入
+  while (true) {
+    ssize_t n = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+    if (n >= 0)
+      return true;
+    if (errno != EINTR)
+      return false;
+  }
+}
+
+bool HandoffRecv(int sock, HandoffHeader *header, std::vector<int> *fds,
+                 std::string *payload) {
+  payload->resize(kHandoffMaxPayload);
+  iovec iov[2];
+  iov[0].iov_base = header;
+  iov[0].iov_len = sizeof(*header);
+  iov[1].iov_base = &(*payload)[0];
+  iov[1].iov_len = payload->size();
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kHandoffMaxFds)];
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0)
+    return false;
+  // 先收下 fd, 即便消息本身不合法也不能泄漏
+  for (cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+    if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+      continue;
+    std::size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const int *data = reinterpret_cast<const int *>(CMSG_DATA(cm));
+    fds->insert(fds->end(), data, data + count);
+  }
+  if (n < static_cast<ssize_t>(sizeof(*header)) || (msg.msg_flags & MSG_TRUNC))
+    return false;
+  if (header->payloadLen != n - sizeof(*header))
+    return false;
+  payload->resize(header->payloadLen);
+  return true;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file Handoff.hpp
+ * @author JDongChen
+ * @brief 进程间交接 socket 的消息格式, 经 Unix socket 以 SCM_RIGHTS 传递 fd
+ * @version 0.1
+ * @date 2022-09-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_HANDOFF_H
+#define SNOWY_HANDOFF_H
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 交接消息类型
+ *
+ * 旧进程依次发送 Listen (可多条) 与 Connection，最后发送 Done。连接在旧
+ * 进程中已读出但未处理的数据放在 Connection 的负载里，超过一条消息能容纳
+ * 的部分用紧随其后的 ConnectionData 续传。
+ */
+enum class HandoffMsg : uint32_t {
+  Listen = 1,         // fds 为监听 socket
+  Connection = 2,     // fds[0] 为已连接 socket, peer 有效
+  ConnectionData = 3, // 追加到上一条 Connection 的负载
+  Done = 4,
+};
+
+struct HandoffHeader {
+  uint32_t type;
+  uint32_t fdCount;
+  uint32_t payloadLen;
+  sockaddr_in peer;
+};
+
+///@brief 单条消息最多携带的 fd 数与负载字节数
+static const std::size_t kHandoffMaxFds = 64;
+static const std::size_t kHandoffMaxPayload = 32 * 1024;
+
+/**
+ * @brief 在 path 上监听 SOCK_SEQPACKET Unix socket
+ *
+ * path 以 '@' 开头时使用抽象命名空间，否则先 unlink 已存在的文件。
+ * @return 监听 fd, 失败返回 -1
+ */
+int HandoffListen(const std::string &path);
+///@brief 连接到 HandoffListen 的 path, 失败返回 -1
+int HandoffConnect(const std::string &path);
+
+///@brief 阻塞发送一条消息, fdCount 不超过 kHandoffMaxFds, len 不超过 kHandoffMaxPayload
+bool HandoffSend(int sock, HandoffMsg type, const int *fds,
+                 std::size_t fdCount, const sockaddr_in *peer,
+                 const void *payload, std::size_t len);
+///@brief 阻塞接收一条消息, 收到的 fd 追加到 fds, 对端关闭或出错返回 false
+bool HandoffRecv(int sock, HandoffHeader *header, std::vector<int> *fds,
+                 std::string *payload);
+
+#endif
@@ -0,0 +1,341 @@
+/**
+ * @file IoUringPoller.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-08-29
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "IoUringPoller.hpp"
+
+static int io_uring_setup(unsigned entries, io_uring_params *p) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                          unsigned flags, void *arg, std::size_t argSize) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                    minComplete, flags, arg, argSize));
+}
+
+static uint32_t _ToPollMask(int events) {
+  uint32_t mask = 0;
+  if (events & EPOLL_ET_Read)
+    mask |= EPOLLIN | EPOLLRDHUP;
+  if (events & EPOLL_ET_Write)
+    mask |= EPOLLOUT;
+  return mask;
+}
+
+IoUringPoller::IoUringPoller(unsigned entries) {
+  io_uring_params params;
+  ::memset(&params, 0, sizeof(params));
+  int fd = io_uring_setup(entries, &params);
+  if (fd < 0) {
+    printf("io_uring_setup failed: %s\n", strerror(errno));
+    return;
+  }
+
+  ringSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMmap && cqRingSize_ > ringSize_)
+    ringSize_ = cqRingSize_;
+
+  ringPtr_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ringPtr_ == MAP_FAILED) {
+    ::close(fd);
+    ringPtr_ = nullptr;
+    return;
+  }
+  if (singleMmap) {
+    cqRingPtr_ = ringPtr_;
+  } else {
+    cqRingPtr_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cqRingPtr_ == MAP_FAILED) {
+      ::munmap(ringPtr_, ringSize_);
+      ::close(fd);
+      ringPtr_ = cqRingPtr_ = nullptr;
+      return;
+    }
+  }
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    if (cqRingPtr_ != ringPtr_)
+      ::munmap(cqRingPtr_, cqRingSize_);
+    ::munmap(ringPtr_, ringSize_);
+    ::close(fd);
+    ringPtr_ = cqRingPtr_ = nullptr;
+    return;
+  }
+
+  char *sq = static_cast<char *>(ringPtr_);
+  sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sqEntries_ = params.sq_entries;
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  char *cq = static_cast<char *>(cqRingPtr_);
+  cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  multiplexer_ = fd;
+  // Poll 的超时需要 IORING_ENTER_EXT_ARG (5.11), 边沿触发需要 multishot
+  // poll (5.13), 缺少任一项时让 EventLoop 退回 epoll
+  if (!(params.features & IORING_FEAT_EXT_ARG) || !_ProbeMultishot()) {
+    printf("io_uring lacks ext_arg or multishot poll\n");
+    _Close();
+    return;
+  }
+  printf("create IoUringPoller: %d\n", multiplexer_);
+}
+
+IoUringPoller::~IoUringPoller() {
+  if (multiplexer_ == -1)
+    return;
+  printf("close IoUringPoller: %d\n", multiplexer_);
+  _Close();
+}
+
+void IoUringPoller::_Close() {
+  ::munmap(sqes_, sqesSize_);
+  if (cqRingPtr_ != ringPtr_)
+    ::munmap(cqRingPtr_, cqRingSize_);
+  ::munmap(ringPtr_, ringSize_);
+  ::close(multiplexer_);
+  multiplexer_ = -1;
+}
+
+bool IoUringPoller::_ProbeMultishot() {
+  // 对一个已就绪的 eventfd 提交 multishot poll, 旧内核拒绝 len 非 0
+  // 的 POLL_ADD, 或者只完成一次而不带 IORING_CQE_F_MORE
+  int efd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd < 0)
+    return false;
+  io_uring_sqe *sqe = _GetSqe();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = efd;
+  sqe->poll32_events = EPOLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = _UserData(efd, 0);
+  bool multishot = false;
+  if (_Enter(1, 1000) >= 0) {
+    unsigned head = *cqHead_;
+    if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe &cqe = cqes_[head & *cqMask_];
+      multishot = cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE);
+    }
+  }
+  // 代数为 0 的 CQE 在 Poll 中被忽略, 移除请求及其结果无需等待
+  sqe = _GetSqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = _UserData(efd, 0);
+  sqe->user_data = _UserData(efd, 0);
+  _Enter(0, 0);
+  __atomic_store_n(cqHead_, __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  ::close(efd);
+  return multishot;
+}
+
+io_uring_sqe *IoUringPoller::_GetSqe() {
+  unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  unsigned tail = *sqTail_;
+  if (tail - head >= sqEntries_) {
+    // 提交队列已满, 先提交再取
+    _Enter(0, 0);
+    head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (tail - head >= sqEntries_)
+      return nullptr;
+  }
+  unsigned index = tail & *sqMask_;
+  io_uring_sqe *sqe = &sqes_[index];
+  ::memset(sqe, 0, sizeof(*sqe));
+  sqArray_[index] = index;
+  __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+  ++toSubmit_;
+  return sqe;
+}
+
+void IoUringPoller::_PollAdd(int fd, const Watch &w) {
+  io_uring_sqe *sqe = _GetSqe();
+  if (!sqe) {
+    pending_.push_back(PendingOp{fd, w.gen, false});
+    return;
+  }
+  ++ctlCount_;
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = w.mask;
+  // 水平触发用单次 poll, 每次触发后重新提交, 提交时若仍就绪会立即完成
+  sqe->len = w.level ? 0 : IORING_POLL_ADD_MULTI;
+  sqe->user_data = _UserData(fd, w.gen);
+}
+
+void IoUringPoller::_PollRemove(int fd, uint32_t gen) {
+  io_uring_sqe *sqe = _GetSqe();
+  if (!sqe) {
+    // 旧请求的 CQE 代数不匹配会被丢弃, 但它持有文件引用, 仍须移除
+    pending_.push_back(PendingOp{fd, gen, true});
+    return;
+  }
+  ++ctlCount_;
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = _UserData(fd, gen);
+  sqe->user_data = _UserData(fd, 0);
+}
+
+void IoUringPoller::_RetryPending() {
+  std::vector<PendingOp> ops;
+  ops.swap(pending_);
+  for (const PendingOp &op : ops) {
+    if (op.remove) {
+      _PollRemove(op.fd, op.gen);
+      continue;
+    }
+    // 期间被 Modify/Unregister 的 fd 已有新请求或不再关注
+    auto it = watches_.find(op.fd);
+    if (it != watches_.end() && it->second.gen == op.gen)
+      _PollAdd(op.fd, it->second);
+  }
+}
+
+int IoUringPoller::_Enter(unsigned minComplete, int timeoutMs) {
+  unsigned flags = 0;
+  io_uring_getevents_arg arg;
+  __kernel_timespec ts;
+  ::memset(&arg, 0, sizeof(arg));
+  if (minComplete > 0) {
+    flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    if (timeoutMs >= 0) {
+      ts.tv_sec = timeoutMs / 1000;
+      ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+      arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+  }
+  int ret;
+  do {
+    ret = io_uring_enter(multiplexer_, toSubmit_, minComplete, flags, &arg,
+                         sizeof(arg));
+  } while (ret < 0 && errno == EINTR && minComplete == 0);
+  if (ret >= 0)
+    toSubmit_ -= ret < static_cast<int>(toSubmit_) ? ret : toSubmit_;
+  return ret;
+}
+
+bool IoUringPoller::Register(int fd, int events, void *userPtr) {
+  if (IsRegistered(fd))
+    return false;
+  Watch w{userPtr, _ToPollMask(events), _NextGen(),
+          (events & EPOLL_ET_Level) != 0};
+  watches_[fd] = w;
+  _SetInterest(fd, events);
+  _PollAdd(fd, w);
+  return true;
+}
+
+bool IoUringPoller::Modify(int fd, int events, void *userPtr) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return false;
+  events = _MergeMode(fd, events);
+  if (Interest(fd) == events && it->second.userPtr == userPtr)
+    return true; // 兴趣未变, 不提交 SQE
+  _PollRemove(fd, it->second.gen);
+  it->second.userPtr = userPtr;
+  it->second.mask = _ToPollMask(events);
+  it->second.gen = _NextGen();
+  _SetInterest(fd, events);
+  _PollAdd(fd, it->second);
+  return true;
+}
+
+bool IoUringPoller::Unregister(int fd, int events) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return false;
+  _PollRemove(fd, it->second.gen);
+  watches_.erase(it);
+  _ClearInterest(fd);
+  // poll 请求持有文件引用, 立即提交以便 close 后连接能真正关闭
+  _Enter(0, 0);
+  return true;
+}
+
+int IoUringPoller::Poll(int timeoutMs, FiredCallback cb, void *ctx) {
+  if (!pending_.empty())
+    _RetryPending();
+  unsigned head = *cqHead_;
+  unsigned ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) - head;
+  // 已有完成事件且没有待提交的 SQE 时直接收割, 不进入内核
+  if (ready == 0 || toSubmit_ > 0) {
+    // 仍有请求没能放进提交队列时不长时间阻塞, 尽快重试
+    if (!pending_.empty() && (timeoutMs < 0 || timeoutMs > 1))
+      timeoutMs = 1;
+    // 已有完成事件时只提交不等待
+    int ret = _Enter(ready > 0 ? 0 : 1, timeoutMs);
+    if (ret < 0 && errno != EINTR && errno != ETIME && errno != EBUSY &&
+        errno != EAGAIN)
+      return -1;
+  }
+
+  std::size_t nFired = 0;
+  unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+  for (; head != tail && nFired < batch_; ++head) {
+    const io_uring_cqe &cqe = cqes_[head & *cqMask_];
+    int fd = static_cast<int>(cqe.user_data >> 32);
+    uint32_t gen = static_cast<uint32_t>(cqe.user_data);
+    if (gen == 0)
+      continue; // POLL_REMOVE 的结果
+    auto it = watches_.find(fd);
+    if (it == watches_.end() || it->second.gen != gen)
+      continue; // 已经 Modify/Unregister 的旧请求
+
+    int events = 0;
+    if (cqe.res < 0) {
+      events |= EPOLL_ET_ERROR;
+    } else {
+      if (cqe.res & (EPOLLIN | EPOLLRDHUP))
+        events |= EPOLL_ET_Read;
+      if (cqe.res & EPOLLOUT)
+        events |= EPOLL_ET_Write;
+      if (cqe.res & EPOLLERR)
+        events |= EPOLL_ET_ErrQueue;
+      if (cqe.res & EPOLLHUP)
+        events |= EPOLL_ET_ERROR;
+    }
+    // 单次 poll 或 multishot 被内核终止 (如 CQ 溢出) 时重新提交;
+    // 须在回调之前, 回调可能 Modify/Unregister 使 it 失效
+    if (cqe.res >= 0 && !(cqe.flags & IORING_CQE_F_MORE))
+      _PollAdd(fd, it->second);
+    void *userPtr = it->second.userPtr;
+    ++nFired;
+    // 先归还 CQE 再回调, 回调中提交 SQE 不会与本次遍历冲突
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    cb(ctx, userPtr, events);
+  }
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  if (nFired == batch_)
+    _GrowBatch();
+  return static_cast<int>(nFired);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file IoUringPoller.hpp
+ * @author JDongChen
+ * @brief 基于 io_uring 的 Poller 实现 (poll 模式)
+ * @version 0.1
+ * @date 2022-08-29
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_IOURINGPOLLER_H
+#define SNOWY_IOURINGPOLLER_H
+
+#include <linux/io_uring.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "Poller.hpp"
+
+/**
+ * @brief io_uring poll 模式
+ *
+ * 每个 fd 提交一个 IORING_OP_POLL_ADD multishot 请求，就绪事件以 CQE
+ * 的形式返回；EPOLL_ET_Level 注册的 fd 使用单次 poll，触发后重新提交。
+ * Register/Modify 只把 SQE 放进提交队列，在下一次 Poll 时与等待合并成
+ * 一次 io_uring_enter，一轮 loop 里的多次兴趣变更因此只需一次系统调用。
+ *
+ * CQE 的 user_data 由 fd 与注册代数组成，fd 被 Modify/Unregister 之后
+ * 迟到的 CQE 代数不匹配，直接丢弃，不会访问已经释放的 Channel。
+ *
+ * 提交队列满时先 io_uring_enter 提交；内核仍不接收 (如 CQ 溢出时的
+ * EBUSY) 时请求暂存，下一次 Poll 时重试，重试前 Poll 至多等待 1ms。
+ * Poll 时若 CQ 中已有事件且没有待提交的 SQE，直接收割而不进入内核。
+ */
+class IoUringPoller : public Poller {
+public:
+  explicit IoUringPoller(unsigned entries = 1024);
+  ~IoUringPoller();
+
+  IoUringPoller(const IoUringPoller &) = delete;
+  void operator=(const IoUringPoller &) = delete;
+
+  ///@brief 内核不支持 (早于 5.13) 或被 seccomp 禁止时返回 false
+  bool Valid() const { return multiplexer_ != -1; }
+
+public:
+  bool Register(int fd, int events, void *userPtr) override;
+  bool Modify(int fd, int events, void *userPtr) override;
+  bool Unregister(int fd, int events) override;
+  int Poll(int timeoutMs, FiredCallback cb, void *ctx) override;
+
+private:
+  struct Watch {
+    void *userPtr;
+    uint32_t mask;
+    uint32_t gen;
+    bool level;
+  };
+
+  ///@brief 放不进提交队列的 POLL_ADD / POLL_REMOVE
+  struct PendingOp {
+    int fd;
+    uint32_t gen;
+    bool remove;
+  };
+
+  void _Close();
+  ///@brief 内核是否支持 IORING_POLL_ADD_MULTI
+  bool _ProbeMultishot();
+  io_uring_sqe *_GetSqe();
+  void _PollAdd(int fd, const Watch &w);
+  void _PollRemove(int fd, uint32_t gen);
+  void _RetryPending();
+  int _Enter(unsigned minComplete, int timeoutMs);
+
+  uint32_t _NextGen() {
+    if (nextGen_ == 0)
+      nextGen_ = 1;
+    return nextGen_++;
+  }
+  static uint64_t _UserData(int fd, uint32_t gen) {
+    return (static_cast<uint64_t>(fd) << 32) | gen;
+  }
+
+  // SQ ring
+  unsigned *sqHead_ = nullptr;
+  unsigned *sqTail_ = nullptr;
+  unsigned *sqMask_ = nullptr;
+  unsigned *sqArray_ = nullptr;
+  io_uring_sqe *sqes_ = nullptr;
+  unsigned sqEntries_ = 0;
+  unsigned toSubmit_ = 0;
+  // CQ ring
+  unsigned *cqHead_ = nullptr;
+  unsigned *cqTail_ = nullptr;
+  unsigned *cqMask_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+
+  void *ringPtr_ = nullptr;
+  std::size_t ringSize_ = 0;
+  void *cqRingPtr_ = nullptr;
+  std::size_t cqRingSize_ = 0;
+  std::size_t sqesSize_ = 0;
+
+  uint32_t nextGen_ = 1; // 0 保留给不需要处理的 CQE
+  std::unordered_map<int, Watch> watches_;
+  std::vector<PendingOp> pending_;
+};
+
+#endif
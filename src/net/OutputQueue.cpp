@@ -0,0 +1,221 @@
+/**
+ * @file OutputQueue.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-09-05
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "OutputQueue.hpp"
+
+OutputQueue::FileRegion::~FileRegion() { ::close(fd); }
+
+OutputQueue::~OutputQueue() {
+  if (pipe_[0] != -1) {
+    ::close(pipe_[0]);
+    ::close(pipe_[1]);
+  }
+}
+
+void OutputQueue::Append(IoSlice slice) {
+  if (slice.len == 0)
+    return;
+  bytes_ += slice.len;
+  slices_.push_back(Entry{std::move(slice), nullptr, nullptr});
+}
+
+void OutputQueue::AppendCopy(const void *data, std::size_t len) {
+  if (len == 0)
+    return;
+  const char *ptr = static_cast<const char *>(data);
+  bytes_ += len;
+  if (!slices_.empty() && slices_.back().copy &&
+      slices_.back().slice.len + len <= kCoalesceLimit_) {
+    // 追加到队尾的拷贝分片, string 可能重新分配, 需要按偏移重算 data
+    Entry &back = slices_.back();
+    std::size_t offset = back.slice.data - back.copy->data();
+    back.copy->append(ptr, len);
+    back.slice.data = back.copy->data() + offset;
+    back.slice.len += len;
+    return;
+  }
+  auto copy = std::make_shared<std::string>(ptr, len);
+  copy->reserve(kCoalesceLimit_);
+  slices_.push_back(Entry{IoSlice{copy, copy->data(), len}, copy, nullptr});
+}
+
+bool OutputQueue::AppendFile(int fd, off_t offset, std::size_t len) {
+  if (len == 0)
+    return true;
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+    return false;
+  int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (dupfd < 0)
+    return false;
+  auto file = std::make_shared<FileRegion>();
+  file->fd = dupfd;
+  file->offset = offset;
+  file->remaining = len;
+  file->regular = S_ISREG(st.st_mode);
+  slices_.push_back(Entry{IoSlice{nullptr, nullptr, 0}, nullptr, file});
+  return true;
+}
+
+void OutputQueue::_Consume(std::size_t n) {
+  bytes_ -= n;
+  while (n > 0) {
+    IoSlice &front = slices_.front().slice;
+    if (n < front.len) {
+      front.data += n;
+      front.len -= n;
+      return;
+    }
+    n -= front.len;
+    slices_.pop_front();
+  }
+}
+
+bool OutputQueue::Flush(int fd) {
+  iovec iov[IOV_MAX];
+  bool zcFallback = false;
+  sourceStalled_ = false;
+  while (!slices_.empty()) {
+    if (slices_.front().file) {
+      FileRegion &file = *slices_.front().file;
+      FileResult res =
+          file.regular ? _SendFile(fd, file) : _SpliceFile(fd, file);
+      if (res == FileResult::Again)
+        return true;
+      if (res == FileResult::SourceEmpty) {
+        sourceStalled_ = true;
+        return true;
+      }
+      if (res == FileResult::Error)
+        return false;
+      slices_.pop_front();
+      continue;
+    }
+    // 收集到下一个文件区间为止的内存分片, 零拷贝模式下只收集同类分片
+    const bool zcMode = zeroCopyThreshold_ > 0 && !zcFallback;
+    const bool frontCopy = slices_.front().copy != nullptr;
+    std::size_t count = 0, total = 0;
+    for (auto it = slices_.begin(); it != slices_.end() && !it->file &&
+                                    count < IOV_MAX &&
+                                    (!zcMode || !it->copy == !frontCopy);
+         ++it, ++count) {
+      iov[count].iov_base = const_cast<char *>(it->slice.data);
+      iov[count].iov_len = it->slice.len;
+      total += it->slice.len;
+    }
+    const bool zc = zcMode && !frontCopy && total >= zeroCopyThreshold_;
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    // sendmsg 而不是 writev, 以便带上 MSG_NOSIGNAL
+    ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (zc ? MSG_ZEROCOPY : 0));
+    if (n > 0) {
+      if (zc)
+        _PinZeroCopy(n);
+      _Consume(n);
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true; // 等待下一次可写
+    } else if (n < 0 && errno == ENOBUFS && zc) {
+      zcFallback = true; // 超出 optmem 限制, 本次改为普通发送
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void OutputQueue::_PinZeroCopy(std::size_t n) {
+  ZeroCopyPending pending{zcNextSeq_++, {}};
+  for (auto it = slices_.begin(); n > 0; ++it) {
+    pending.owners.push_back(it->slice.owner);
+    n -= std::min(n, it->slice.len);
+  }
+  zcPending_.push_back(std::move(pending));
+}
+
+void OutputQueue::CompleteZeroCopy(uint32_t lo, uint32_t hi) {
+  // 序号会回绕, 按无符号差值判断是否落在 [lo, hi]
+  for (auto it = zcPending_.begin(); it != zcPending_.end();) {
+    if (it->seq - lo <= hi - lo)
+      it = zcPending_.erase(it);
+    else
+      ++it;
+  }
+}
+
+OutputQueue::FileResult OutputQueue::_SendFile(int sock, FileRegion &file) {
+  while (file.remaining > 0) {
+    // 单次 sendfile 最多传输约 2GB
+    std::size_t chunk = std::min<std::size_t>(file.remaining, 1 << 30);
+    ssize_t n = ::sendfile(sock, file.fd, &file.offset, chunk);
+    if (n > 0) {
+      file.remaining -= n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return FileResult::Again;
+    } else {
+      return FileResult::Error; // 出错或文件在发送过程中被截断
+    }
+  }
+  return FileResult::Done;
+}
+
+OutputQueue::FileResult OutputQueue::_SpliceFile(int sock, FileRegion &file) {
+  if (pipe_[0] == -1 && ::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) != 0) {
+    pipe_[0] = pipe_[1] = -1;
+    return FileResult::Error;
+  }
+  const unsigned flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+  while (pipeBytes_ > 0 || file.remaining > 0) {
+    if (pipeBytes_ > 0) {
+      // 先把管道中已有的数据写到 socket
+      ssize_t n = ::splice(pipe_[0], nullptr, sock, nullptr, pipeBytes_,
+                           flags | SPLICE_F_MORE);
+      if (n > 0) {
+        pipeBytes_ -= n;
+        continue;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && errno == EAGAIN)
+        return FileResult::Again;
+      return FileResult::Error;
+    }
+    ssize_t n = ::splice(file.fd, nullptr, pipe_[1], nullptr,
+                         std::min<std::size_t>(file.remaining, 64 * 1024),
+                         flags);
+    if (n > 0) {
+      file.remaining -= n;
+      pipeBytes_ += n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      return FileResult::SourceEmpty;
+    } else {
+      return FileResult::Error; // 提前 EOF 或出错
+    }
+  }
+  return FileResult::Done;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file OutputQueue.hpp
+ * @author JDongChen
+ * @brief Connection 的发送队列, 由引用计数的分片组成, sendmsg 批量发送
+ * @version 0.1
+ * @date 2022-09-05
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_OUTPUTQUEUE_H
+#define SNOWY_OUTPUTQUEUE_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 待发送的一段连续内存, owner 保证 data 在发送完成前有效
+ */
+struct IoSlice {
+  std::shared_ptr<const void> owner;
+  const char *data;
+  std::size_t len;
+};
+
+/**
+ * @brief 分片发送队列
+ *
+ * Append 只记录分片不拷贝数据，AppendCopy 用于调用者无法保证生命周期的
+ * 数据，小块拷贝会合并到同一个分片里。Flush 每次最多把 IOV_MAX 个分片
+ * 交给一次 sendmsg。
+ *
+ * AppendFile 在队列中插入一段文件，按顺序与内存分片交错发送：普通文件
+ * 用 sendfile，其他 fd (管道、字符设备等) 经内部管道 splice。
+ *
+ * 开启零拷贝后，连续的引用分片合计不小于阈值时以 MSG_ZEROCOPY 发送，
+ * 分片的 owner 一直保留到内核通过错误队列报告完成。AppendCopy 的拷贝
+ * 分片会被继续追加，不走零拷贝。
+ */
+class OutputQueue {
+public:
+  OutputQueue() = default;
+  ~OutputQueue();
+  OutputQueue(const OutputQueue &) = delete;
+  void operator=(const OutputQueue &) = delete;
+
+  void Append(IoSlice slice);
+  void AppendCopy(const void *data, std::size_t len);
+  /**
+   * @brief 追加文件区间 [offset, offset + len)
+   *
+   * 队列持有 fd 的副本，调用者可以立即关闭自己的 fd。非普通文件忽略
+   * offset 并从当前位置读取，读端暂时无数据时 Flush 返回且 SourceStalled
+   * 为 true，socket 仍可写，不会再有可写事件，需由调用者稍后重试。
+   * @return dup 或 fstat 失败时返回 false
+   */
+  bool AppendFile(int fd, off_t offset, std::size_t len);
+
+  bool empty() const { return slices_.empty(); }
+  ///@brief 排队的内存字节数, 文件区间不占内存, 不计入
+  std::size_t readableSize() const { return bytes_; }
+
+  /**
+   * @brief 尽量写出队列中的数据
+   * @return 遇到 EAGAIN 或发送完毕返回 true，连接出错返回 false
+   */
+  bool Flush(int fd);
+  ///@brief 上一次 Flush 因文件区间的读端暂时无数据而停止
+  bool SourceStalled() const { return sourceStalled_; }
+
+  ///@brief threshold 为 0 表示关闭, socket 须已设置 SO_ZEROCOPY
+  void EnableZeroCopy(std::size_t threshold) { zeroCopyThreshold_ = threshold; }
+  ///@brief 内核报告第 [lo, hi] 次零拷贝发送完成, 释放对应分片
+  void CompleteZeroCopy(uint32_t lo, uint32_t hi);
+  ///@brief 已发出但内核尚未释放的零拷贝发送次数
+  std::size_t PendingZeroCopy() const { return zcPending_.size(); }
+
+private:
+  struct FileRegion {
+    ~FileRegion();
+    int fd;
+    off_t offset;
+    std::size_t remaining;
+    bool regular;
+  };
+  struct Entry {
+    IoSlice slice;
+    std::shared_ptr<std::string> copy; // 非空表示 AppendCopy 持有的拷贝
+    std::shared_ptr<FileRegion> file;  // 非空表示文件区间, slice 无效
+  };
+  // Again: socket 写满; SourceEmpty: 读端暂时无数据
+  enum class FileResult { Done, Again, SourceEmpty, Error };
+
+  ///@brief 丢弃队首 n 字节内存数据, 不跨越文件区间
+  void _Consume(std::size_t n);
+  ///@brief 零拷贝发出 n 字节后, 保留队首覆盖这些字节的分片直到完成
+  void _PinZeroCopy(std::size_t n);
+  FileResult _SendFile(int sock, FileRegion &file);
+  FileResult _SpliceFile(int sock, FileRegion &file);
+
+  // 小于该大小的拷贝追加到队尾的拷贝分片中
+  static const std::size_t kCoalesceLimit_ = 4096;
+
+  struct ZeroCopyPending {
+    uint32_t seq;
+    std::vector<std::shared_ptr<const void>> owners;
+  };
+
+  std::deque<Entry> slices_;
+  std::size_t bytes_ = 0;
+  std::size_t zeroCopyThreshold_ = 0;
+  uint32_t zcNextSeq_ = 0; // 与内核对每次 MSG_ZEROCOPY 发送的计数一致
+  std::deque<ZeroCopyPending> zcPending_;
+  // splice 用的中转管道, 首次需要时创建, 残留数据属于队首文件区间
+  int pipe_[2] = {-1, -1};
+  std::size_t pipeBytes_ = 0;
+  bool sourceStalled_ = false;
+};
+
+#endif
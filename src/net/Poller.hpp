@@ -18,20 +18,25 @@
 #include <iostream>
 #include <vector>
 
-struct FiredEvent {
-  int events;
-  void *userdata; // use for channe pointer
-
-  FiredEvent() : events(0), userdata(nullptr) {}
-};
-
 enum PollEvent {
   EPOLL_ET_None = 0,
   EPOLL_ET_Read = 0x1 << 0,
   EPOLL_ET_Write = 0x1 << 1,
   EPOLL_ET_ERROR = 0x1 << 2,
+  // 注册时指定的触发模式, 默认边沿触发; Modify 沿用注册时的模式
+  EPOLL_ET_Level = 0x1 << 3,
+  // EPOLLERR: socket 错误队列有数据 (如 MSG_ZEROCOPY 完成通知) 或出错,
+  // 无需注册, 总会上报; 由 Channel::HandleErrQueueEvent 处理
+  EPOLL_ET_ErrQueue = 0x1 << 4,
 };
 
+/**
+ * @brief 就绪事件回调, 在 Poll 内对每个就绪 fd 调用一次
+ * @param userPtr 注册时传入的指针
+ * @param events PollEvent 组合
+ */
+using FiredCallback = void (*)(void *ctx, void *userPtr, int events);
+
 class Poller {
 public:
   Poller() : multiplexer_(-1) {}
@@ -41,12 +46,64 @@ public:
   virtual bool Modify(int fd, int events, void *userPtr) = 0;
   virtual bool Unregister(int fd, int events) = 0;
 
-  virtual int Poll(std::size_t maxEv, int timeoutMs) = 0;
-  const std::vector<FiredEvent> &GetFiredEvents() const { return firedEvents_; }
+  /**
+   * @brief 等待并直接从内核返回的事件数组分发, 不再复制到中间数组
+   *
+   * 一次最多取 batch 个事件，取满说明积压，下次 batch 翻倍直到上限。
+   * 回调中可以 Register/Modify/Unregister。
+   * @return 分发的事件数, 出错返回 -1
+   */
+  virtual int Poll(int timeoutMs, FiredCallback cb, void *ctx) = 0;
+
+  ///@brief 每次 Poll 的事件批大小, 初始 initial, 取满时翻倍至多 max
+  void SetEventBatch(std::size_t initial, std::size_t max) {
+    batch_ = initial == 0 ? 1 : initial;
+    maxBatch_ = max < batch_ ? batch_ : max;
+  }
+  std::size_t EventBatch() const { return batch_; }
+
+  bool IsRegistered(int fd) const { return _Slot(fd) & kRegistered_; }
+  ///@brief 当前注册的事件(含触发模式)
+  int Interest(int fd) const { return _Slot(fd) & ~kRegistered_; }
+  ///@brief 实际发生的兴趣变更系统调用次数 (epoll_ctl / poll SQE)
+  uint64_t CtlCount() const { return ctlCount_; }
+
+protected:
+  static const int kRegistered_ = 0x1 << 30;
+
+  int _Slot(int fd) const {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= interest_.size())
+      return EPOLL_ET_None;
+    return interest_[fd];
+  }
+  void _SetInterest(int fd, int events) {
+    if (static_cast<std::size_t>(fd) >= interest_.size())
+      interest_.resize(fd + 1, EPOLL_ET_None);
+    interest_[fd] = events | kRegistered_;
+  }
+  void _ClearInterest(int fd) {
+    if (static_cast<std::size_t>(fd) < interest_.size())
+      interest_[fd] = EPOLL_ET_None;
+  }
+  ///@brief Modify 时保留注册时的触发模式
+  int _MergeMode(int fd, int events) const {
+    return (events & ~EPOLL_ET_Level) | (Interest(fd) & EPOLL_ET_Level);
+  }
+
+  ///@brief Poll 取满一批后调用
+  void _GrowBatch() {
+    if (batch_ < maxBatch_)
+      batch_ = 2 * batch_ < maxBatch_ ? 2 * batch_ : maxBatch_;
+  }
 
 public:
   int multiplexer_;
-  std::vector<FiredEvent> firedEvents_;
+
+protected:
+  std::vector<int> interest_; // fd 索引, 只在 loop 线程访问
+  uint64_t ctlCount_ = 0;
+  std::size_t batch_ = 64;
+  std::size_t maxBatch_ = 4096;
 };
 
 class Epoller : public Poller {
@@ -61,7 +118,7 @@ public:
   bool Register(int epfd, int events, void *userPtr) override;
   bool Modify(int epfd, int events, void *userPtr) override;
   bool Unregister(int epfd, int events) override;
-  int Poll(std::size_t maxEvent, int timeoutMs) override;
+  int Poll(int timeoutMs, FiredCallback cb, void *ctx) override;
 
 private:
   std::vector<epoll_event> events_;
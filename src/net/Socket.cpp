@@ -1,7 +1,83 @@
+#include <netinet/tcp.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <cerrno>
+
 #include "Socket.hpp"
 
+static const char kUnixPrefix[] = "unix:";
+
+static bool _IsTcp(int sock) {
+  int domain = 0;
+  socklen_t len = sizeof(domain);
+  if (::getsockopt(sock, SOL_SOCKET, SO_DOMAIN, &domain, &len) != 0)
+    return false;
+  return domain == AF_INET || domain == AF_INET6;
+}
+
+// 选项设置失败只打印, 不影响 socket 的正常使用
+static void _SetInt(int sock, int level, int name, int value,
+                    const char *what) {
+  if (::setsockopt(sock, level, name, &value, sizeof(value)) != 0)
+    printf("setsockopt %s failed: %s\n", what, strerror(errno));
+}
+
+static void _SetBuffers(int sock, const SocketOptions &options) {
+  if (options.sendBuffer > 0)
+    _SetInt(sock, SOL_SOCKET, SO_SNDBUF, options.sendBuffer, "SO_SNDBUF");
+  if (options.recvBuffer > 0)
+    _SetInt(sock, SOL_SOCKET, SO_RCVBUF, options.recvBuffer, "SO_RCVBUF");
+}
+
+void ApplyListenOptions(int sock, const SocketOptions &options) {
+  _SetBuffers(sock, options); // accept 出来的连接继承
+  if (!_IsTcp(sock))
+    return;
+  if (options.reuseAddr)
+    _SetInt(sock, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR");
+  if (options.deferAcceptSec > 0)
+    _SetInt(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.deferAcceptSec,
+            "TCP_DEFER_ACCEPT");
+  if (options.fastOpenQueue > 0)
+    _SetInt(sock, IPPROTO_TCP, TCP_FASTOPEN, options.fastOpenQueue,
+            "TCP_FASTOPEN");
+}
+
+void ApplyConnectOptions(int sock, const SocketOptions &options) {
+  _SetBuffers(sock, options); // 窗口扩大因子在握手时确定
+  if (_IsTcp(sock) && options.fastOpenConnect)
+    _SetInt(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1,
+            "TCP_FASTOPEN_CONNECT");
+}
+
+void ApplyConnectionOptions(int sock, const SocketOptions &options) {
+  if (!_IsTcp(sock))
+    return;
+  if (options.tcpNoDelay)
+    _SetInt(sock, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+  if (options.quickAck)
+    _SetInt(sock, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+  if (options.keepAlive) {
+    _SetInt(sock, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+    _SetInt(sock, IPPROTO_TCP, TCP_KEEPIDLE, options.keepIdleSec,
+            "TCP_KEEPIDLE");
+    _SetInt(sock, IPPROTO_TCP, TCP_KEEPINTVL, options.keepIntervalSec,
+            "TCP_KEEPINTVL");
+    _SetInt(sock, IPPROTO_TCP, TCP_KEEPCNT, options.keepCount, "TCP_KEEPCNT");
+  }
+  if (options.notSentLowat > 0)
+    _SetInt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notSentLowat,
+            "TCP_NOTSENT_LOWAT");
+}
+
 int CreateTCPSocket() { return ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP); }
 
+int CreateUDPSocket() {
+  return ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  IPPROTO_UDP);
+}
+
 void SetNonBlock(int sock, bool nonblock) {
   int flag = ::fcntl(sock, F_GETFL, 0);
   assert(flag >= 0 && "Non Block failed");
@@ -11,3 +87,59 @@ void SetNonBlock(int sock, bool nonblock) {
   else
     flag = ::fcntl(sock, F_SETFL, flag & ~O_NONBLOCK);
 }
+
+bool IsUnixAddress(const std::string &address) {
+  return address.compare(0, sizeof(kUnixPrefix) - 1, kUnixPrefix) == 0;
+}
+
+bool FillUnixAddress(const std::string &path, sockaddr_un *addr,
+                     socklen_t *len) {
+  ::memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr->sun_path))
+    return false;
+  ::memcpy(addr->sun_path, path.data(), path.size());
+  const bool abstract = path[0] == '@';
+  if (abstract)
+    addr->sun_path[0] = '\0'; // 抽象命名空间, 长度不含结尾 '\0'
+  *len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() +
+                                (abstract ? 0 : 1));
+  return true;
+}
+
+bool ResolveAddress(const std::string &address, uint16_t port,
+                    sockaddr_storage *addr, socklen_t *len) {
+  ::memset(addr, 0, sizeof(*addr));
+  if (IsUnixAddress(address))
+    return FillUnixAddress(address.substr(sizeof(kUnixPrefix) - 1),
+                           reinterpret_cast<sockaddr_un *>(addr), len);
+  auto in = reinterpret_cast<sockaddr_in *>(addr);
+  in->sin_family = AF_INET;
+  in->sin_port = htons(port);
+  if (::inet_pton(AF_INET, address.c_str(), &in->sin_addr) != 1)
+    return false;
+  *len = sizeof(sockaddr_in);
+  return true;
+}
+
+std::string AddressToString(const sockaddr *addr, socklen_t len) {
+  if (addr->sa_family == AF_INET) {
+    auto in = reinterpret_cast<const sockaddr_in *>(addr);
+    char ip[INET_ADDRSTRLEN] = "";
+    ::inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+    return std::string(ip) + ":" + std::to_string(ntohs(in->sin_port));
+  }
+  if (addr->sa_family == AF_UNIX) {
+    auto un = reinterpret_cast<const sockaddr_un *>(addr);
+    if (len <= offsetof(sockaddr_un, sun_path))
+      return "unix:(unnamed)";
+    std::size_t n = len - offsetof(sockaddr_un, sun_path);
+    std::string path(un->sun_path, n);
+    if (path[0] == '\0')
+      path[0] = '@';
+    else
+      path.resize(::strnlen(path.c_str(), n));
+    return kUnixPrefix + path;
+  }
+  return "(unknown)";
+}
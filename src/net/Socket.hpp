@@ -15,10 +15,57 @@
 #include <arpa/inet.h>
 #include <cassert>
 #include <fcntl.h>
+#include <sys/un.h>
+
+#include <string>
 
 ///@brief Create tcp socket
 int CreateTCPSocket();
+///@brief Create non-blocking udp socket
+int CreateUDPSocket();
 
 void SetNonBlock(int sock, bool nonblock = true);
 
+/**
+ * @brief socket 选项, 由 Acceptor / Connection / Connector 在 listen、accept
+ * 与 connect 时应用
+ *
+ * 只对 TCP socket 有意义的选项在 Unix 域 socket 上自动跳过。缓冲大小为 0
+ * 时保留内核默认值与自动调节。
+ */
+struct SocketOptions {
+  bool reuseAddr = true; // 监听: 重启时不受 TIME_WAIT 连接影响
+  bool tcpNoDelay = true; // 关闭 Nagle, 小的请求/响应帧立即发出
+  int sendBuffer = 0;     // SO_SNDBUF
+  int recvBuffer = 0;     // SO_RCVBUF, 监听 socket 上设置以便协商窗口扩大
+  ///@brief 每次读取前后重设 TCP_QUICKACK, 不等待延迟确认, 读取时多两次系统调用
+  bool quickAck = false;
+  int deferAcceptSec = 0; // 监听: TCP_DEFER_ACCEPT, 对端发来数据后才 accept
+  int fastOpenQueue = 0;  // 监听: TCP_FASTOPEN 队列长度, 0 表示关闭
+  bool fastOpenConnect = false; // 连接: TCP_FASTOPEN_CONNECT
+  bool keepAlive = false;
+  int keepIdleSec = 60; // 空闲多久开始探测
+  int keepIntervalSec = 10;
+  int keepCount = 5;
+  int notSentLowat = 0; // TCP_NOTSENT_LOWAT, 限制内核中未发送的数据量
+};
+
+///@brief bind 之前应用到监听 socket
+void ApplyListenOptions(int sock, const SocketOptions &options);
+///@brief connect 之前应用到主动连接的 socket
+void ApplyConnectOptions(int sock, const SocketOptions &options);
+///@brief 应用到已建立的连接 (accept 或 connect 完成后)
+void ApplyConnectionOptions(int sock, const SocketOptions &options);
+
+///@brief "unix:<path>" 表示 Unix 域 stream socket, 其余按 IPv4 地址解析
+bool IsUnixAddress(const std::string &address);
+///@brief path 以 '@' 开头时为抽象命名空间, 不在文件系统中创建文件
+bool FillUnixAddress(const std::string &path, sockaddr_un *addr,
+                     socklen_t *len);
+///@brief 解析 IPv4 地址 + port 或 "unix:<path>" (忽略 port)
+bool ResolveAddress(const std::string &address, uint16_t port,
+                    sockaddr_storage *addr, socklen_t *len);
+///@brief "ip:port" 或 "unix:<path>", 用于日志
+std::string AddressToString(const sockaddr *addr, socklen_t len);
+
 #endif
\ No newline at end of file
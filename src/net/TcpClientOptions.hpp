@@ -0,0 +1,50 @@
+/**
+ * @file TcpClientOptions.hpp
+ * @author JDongChen
+ * @brief RpcClient 的连接与线程配置
+ * @version 0.1
+ * @date 2022-09-16
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_TCPCLIENTOPTIONS_H
+#define SNOWY_TCPCLIENTOPTIONS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "EventLoop.hpp"
+#include "Socket.hpp"
+
+struct TcpClientOptions {
+  /**
+   * @brief 服务端地址
+   *
+   * "unix:<path>" 使用 Unix 域 stream socket, 此时忽略 port；path 以 '@'
+   * 开头为抽象命名空间, 否则为文件路径
+   */
+  std::string address = "127.0.0.1";
+  uint16_t port = 2468;
+  ///@brief IO loop 数量, 至少为 1
+  std::size_t numLoops = 1;
+  ///@brief 第 i 个 loop 绑定到 cpuAffinity[i % size()], 为空则不绑核
+  std::vector<int> cpuAffinity;
+  ///@brief 第 i 个 loop 线程名为 "<threadName>-<i>", 超过 15 字节截断
+  std::string threadName = "snowy-cli";
+  PollerType pollerType = PollerType::Epoll;
+  ///@brief connect 前与连接建立后应用的 socket 选项
+  SocketOptions socket;
+  ///@brief 单次 connect 超时, 失败后按指数退避重试, 见 Connector
+  std::chrono::milliseconds connectTimeout{3000};
+  std::chrono::milliseconds reconnectInitialDelay{100};
+  std::chrono::milliseconds reconnectMaxDelay{10000};
+  ///@brief 首次失败后的重试次数, 小于 0 表示一直重试
+  int connectRetries = 5;
+
+  std::size_t LoopCount() const { return numLoops == 0 ? 1 : numLoops; }
+};
+
+#endif
@@ -1,13 +1,50 @@
 #include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <condition_variable>
+#include <future>
+#include <random>
 
+#include "Handoff.hpp"
 #include "TcpServer.hpp"
 
-TcpServer::TcpServer() {
-  loop_.reset(new EventLoop());
+void SetupLoopThread(const std::string &threadName,
+                     const std::vector<int> &cpuAffinity, std::size_t index) {
+  std::string name = threadName + "-" + std::to_string(index);
+  if (name.size() > 15)
+    name.resize(15); // pthread 线程名上限 16 字节
+  ::pthread_setname_np(::pthread_self(), name.c_str());
+
+  if (cpuAffinity.empty())
+    return;
+  int cpu = cpuAffinity[index % cpuAffinity.size()];
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset);
+  if (ret != 0)
+    printf("pin %s to cpu %d failed: %s\n", name.c_str(), cpu, strerror(ret));
+}
+
+TcpServer::TcpServer(const TcpServerOptions &options) : options_(options) {
+  loop_.reset(new EventLoop(options_.pollerType));
+  loop_->SetEventBatch(options_.eventBatch, options_.maxEventBatch);
   thread_pool_.clear();
 }
 TcpServer::~TcpServer() {
+  stopping_ = true;
+  if (handoffThread_.joinable())
+    handoffThread_.join();
+  if (handoffSock_ >= 0)
+    ::close(handoffSock_);
+  for (int fd : inheritedListenFds_)
+    ::close(fd);
+  for (auto &conn : inheritedConns_)
+    ::close(conn.fd);
   loop_.reset();
   for (auto &thread : thread_pool_) {
     if (thread.joinable()) {
@@ -17,39 +54,311 @@ TcpServer::~TcpServer() {
 }
 
 void TcpServer::Listen() {
-  auto func = [this]() {
-    auto acc = std::make_shared<Acceptor>(loop_);
+  std::vector<int> inherited;
+  inherited.swap(inheritedListenFds_);
+  // Unix 域 socket 不支持 SO_REUSEPORT, 只用一个 Acceptor
+  if (options_.reusePort && !IsUnixAddress(options_.address)) {
+    // 接管的监听 socket 轮流分给各 loop, 不足的再新建, 加入同一 reuseport 组
+    std::size_t count = std::max(loops_.size(), inherited.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      auto loop = loops_[i % loops_.size()];
+      int fd = i < inherited.size() ? inherited[i] : -1;
+      loop->RunInThisLoop([this, loop, fd]() { _AddAcceptor(loop, fd, true); });
+    }
+  } else if (inherited.empty()) {
+    loop_->RunInThisLoop([this]() { _AddAcceptor(loop_, -1, false); });
+  } else {
+    for (int fd : inherited)
+      loop_->RunInThisLoop([this, fd]() { _AddAcceptor(loop_, fd, false); });
+  }
+  _AdoptInheritedConnections();
+}
+
+void TcpServer::_AddAcceptor(std::shared_ptr<EventLoop> loop, int listenFd,
+                             bool reusePort) {
+  auto acc = std::make_shared<Acceptor>(loop);
+  if (reusePort) {
+    acc->setMakeNewConnection(
+        [this, loop](int connfd, const sockaddr_in &peer) {
+          newConnectionInLoop(loop, connfd, peer);
+        });
+  } else {
     auto newConnFunc = std::bind(&TcpServer::makeNewConnection, this,
                                  std::placeholders::_1, std::placeholders::_2);
     acc->setMakeNewConnection(newConnFunc);
-    acc->BindAndListen();
-    loop_->Register(EPOLL_ET_Read, acc);
-  };
+  }
+  acc->SetSocketOptions(options_.socket);
+  if (listenFd >= 0)
+    acc->Adopt(listenFd);
+  else
+    acc->BindAndListen(options_.address, options_.port, options_.backlog,
+                       reusePort);
+  loop->Register(EPOLL_ET_Read | EPOLL_ET_Level, acc);
+  std::lock_guard<std::mutex> guard(acceptorsMutex_);
+  acceptors_.emplace_back(loop, acc);
+}
 
-  loop_->RunInThisLoop(func);
+void TcpServer::_AdoptInheritedConnections() {
+  for (auto &inherited : inheritedConns_) {
+    auto loop = _getNextLoop();
+    loop->AddPlacing();
+    auto func = [this, loop, inherited]() {
+      auto conn = newConnectionInLoop(loop, inherited.fd, inherited.peer);
+      conn->InjectReceived(inherited.pending);
+      loop->RemovePlacing();
+    };
+    loop->RunInThisLoop(func);
+  }
+  inheritedConns_.clear();
 }
 
 void TcpServer::Start() {
   _StartWorkers();
   printf("start workers...\n");
   Listen();
+  if (handoffSock_ >= 0) {
+    // 在 Listen 之后启动, 交接时 loop 中的 Acceptor 已经创建
+    int sock = handoffSock_;
+    handoffSock_ = -1;
+    handoffThread_ = std::thread([this, sock]() { _Handoff(sock); });
+  }
   loop_->Run();
   printf("Stopped BaseEventLoop...\n");
 
   for (auto &thread : thread_pool_) {
     thread.join();
   }
+  if (handoffThread_.joinable())
+    handoffThread_.join();
   loops_.clear();
   printf("Stopped WorkerEventLoops...\n");
 }
 
+void TcpServer::Stop() {
+  stopping_ = true;
+  for (auto &loop : loops_)
+    loop->Stop();
+  loop_->Stop();
+}
+
+bool TcpServer::TakeOver(const std::string &path) {
+  int sock = HandoffConnect(path);
+  if (sock < 0) {
+    printf("no server to take over at %s\n", path.c_str());
+    return false;
+  }
+  bool done = false;
+  HandoffHeader header;
+  std::vector<int> fds;
+  std::string payload;
+  while (!done) {
+    fds.clear();
+    if (!HandoffRecv(sock, &header, &fds, &payload)) {
+      for (int fd : fds)
+        ::close(fd);
+      break;
+    }
+    switch (static_cast<HandoffMsg>(header.type)) {
+    case HandoffMsg::Listen:
+      inheritedListenFds_.insert(inheritedListenFds_.end(), fds.begin(),
+                                 fds.end());
+      break;
+    case HandoffMsg::Connection:
+      if (fds.size() == 1) {
+        inheritedConns_.push_back({fds[0], header.peer, payload});
+        break;
+      }
+      for (int fd : fds)
+        ::close(fd);
+      break;
+    case HandoffMsg::ConnectionData:
+      if (!inheritedConns_.empty())
+        inheritedConns_.back().pending += payload;
+      break;
+    case HandoffMsg::Done:
+      done = true;
+      break;
+    default:
+      for (int fd : fds)
+        ::close(fd);
+      break;
+    }
+  }
+  ::close(sock);
+  printf("took over %zu listeners, %zu connections%s\n",
+         inheritedListenFds_.size(), inheritedConns_.size(),
+         done ? "" : " (incomplete)");
+  return done;
+}
+
+bool TcpServer::ServeHandoff(const std::string &path) {
+  assert(handoffSock_ < 0);
+  handoffSock_ = HandoffListen(path);
+  handoffPath_ = path;
+  return handoffSock_ >= 0;
+}
+
+/**
+ * @brief 在 loop 线程中执行 fn 并等待完成
+ *
+ * fn 写入的数据需由 fn 自己持有, 等待期间 server 停止时直接放弃
+ */
+static bool _RunAndWait(const std::shared_ptr<EventLoop> &loop,
+                        std::function<void()> fn,
+                        const std::atomic<bool> &stopping) {
+  auto done = std::make_shared<std::promise<void>>();
+  auto future = done->get_future();
+  loop->RunInThisLoop([fn, done]() {
+    fn();
+    done->set_value();
+  });
+  while (future.wait_for(std::chrono::milliseconds(100)) !=
+         std::future_status::ready) {
+    if (stopping)
+      return false;
+  }
+  return true;
+}
+
+void TcpServer::_Handoff(int sock) {
+  int peer = -1;
+  while (!stopping_ && peer < 0) {
+    pollfd pfd{sock, POLLIN, 0};
+    if (::poll(&pfd, 1, 200) > 0)
+      peer = ::accept4(sock, nullptr, nullptr, SOCK_CLOEXEC);
+  }
+  ::close(sock);
+  if (handoffPath_[0] != '@')
+    ::unlink(handoffPath_.c_str());
+  if (peer < 0)
+    return;
+  printf("handing off to new process...\n");
+
+  // 1. 各 loop 停止 accept, 监听 socket 在发送完之前由 acceptors 保持打开
+  using AcceptorList = decltype(acceptors_);
+  auto acceptors = std::make_shared<AcceptorList>();
+  std::vector<std::shared_ptr<EventLoop>> allLoops(loops_);
+  allLoops.push_back(loop_);
+  for (auto &loop : allLoops) {
+    auto func = [this, loop, acceptors]() {
+      std::lock_guard<std::mutex> guard(acceptorsMutex_);
+      for (auto it = acceptors_.begin(); it != acceptors_.end();) {
+        if (it->first != loop) {
+          ++it;
+          continue;
+        }
+        loop->Unregister(EPOLL_ET_Read | EPOLL_ET_Level, it->second);
+        acceptors->push_back(std::move(*it));
+        it = acceptors_.erase(it);
+      }
+    };
+    if (!_RunAndWait(loop, func, stopping_)) {
+      ::close(peer);
+      return;
+    }
+  }
+  std::vector<int> listenFds;
+  for (auto &acc : *acceptors)
+    listenFds.push_back(acc.second->Identifier());
+  bool ok = true;
+  for (std::size_t i = 0; ok && i < listenFds.size(); i += kHandoffMaxFds) {
+    std::size_t n = std::min(kHandoffMaxFds, listenFds.size() - i);
+    ok = HandoffSend(peer, HandoffMsg::Listen, &listenFds[i], n, nullptr,
+                     nullptr, 0);
+  }
+  if (!ok) {
+    // 新进程没有拿到监听 socket, 恢复 accept 继续服务
+    for (auto &acc : *acceptors) {
+      auto loop = acc.first;
+      auto acceptor = acc.second;
+      loop->RunInThisLoop([this, loop, acceptor]() {
+        loop->Register(EPOLL_ET_Read | EPOLL_ET_Level, acceptor);
+        std::lock_guard<std::mutex> guard(acceptorsMutex_);
+        acceptors_.emplace_back(loop, acceptor);
+      });
+    }
+    ::close(peer);
+    printf("handoff failed, keep serving\n");
+    return;
+  }
+  acceptors->clear(); // 新进程已持有监听 socket, 本进程关闭自己的引用
+
+  // 2. 交出空闲连接, 其余连接留在本进程处理完
+  std::size_t handed = 0;
+  if (options_.handoffConnections) {
+    auto detached = std::make_shared<std::vector<InheritedConnection>>();
+    for (auto &loop : loops_) {
+      auto func = [loop, detached]() {
+        loop->ForEachChannel([detached](Channel *ch) {
+          auto conn = dynamic_cast<Connection *>(ch);
+          InheritedConnection ic;
+          if (conn && conn->Detach(&ic.fd, &ic.peer, &ic.pending))
+            detached->push_back(std::move(ic));
+        });
+      };
+      if (!_RunAndWait(loop, func, stopping_))
+        break;
+    }
+    for (auto &ic : *detached) {
+      std::size_t first = std::min(ic.pending.size(), kHandoffMaxPayload);
+      ok = ok && HandoffSend(peer, HandoffMsg::Connection, &ic.fd, 1, &ic.peer,
+                             ic.pending.data(), first);
+      for (std::size_t off = first; ok && off < ic.pending.size();
+           off += kHandoffMaxPayload) {
+        std::size_t n = std::min(kHandoffMaxPayload, ic.pending.size() - off);
+        ok = HandoffSend(peer, HandoffMsg::ConnectionData, nullptr, 0, nullptr,
+                         ic.pending.data() + off, n);
+      }
+      if (ok)
+        ++handed;
+      ::close(ic.fd); // 发送失败的连接只能关闭
+    }
+  }
+  if (ok)
+    ok = HandoffSend(peer, HandoffMsg::Done, nullptr, 0, nullptr, nullptr, 0);
+  ::close(peer);
+  printf("handoff %s: %zu listeners, %zu connections\n",
+         ok ? "done" : "failed", listenFds.size(), handed);
+
+  // 3. 等待剩余连接处理完
+  _Drain();
+  Stop();
+}
+
+void TcpServer::_Drain() {
+  auto deadline = std::chrono::steady_clock::now() + options_.drainTimeout;
+  while (!stopping_) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      printf("drain timeout, closing remaining connections\n");
+      return;
+    }
+    std::size_t remaining = 0;
+    for (auto &loop : loops_) {
+      remaining += loop->ConnectionCount();
+      loop->RunInThisLoop([loop]() {
+        loop->ForEachChannel([](Channel *ch) {
+          if (auto conn = dynamic_cast<Connection *>(ch))
+            conn->CloseIfIdle();
+        });
+      });
+    }
+    if (remaining == 0)
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
 void TcpServer::_StartWorkers() {
   std::mutex pool_mutex;
   std::condition_variable cond;
-  std::size_t numLoop = 8;
+  std::size_t numLoop = options_.LoopCount();
   for (size_t i = 0; i < numLoop; ++i) {
-    auto func = [this, &pool_mutex, &cond, numLoop]() {
-      auto loop = std::make_shared<EventLoop>();
+    auto func = [this, &pool_mutex, &cond, numLoop, i]() {
+      SetupLoopThread(options_, i);
+      auto loop = std::make_shared<EventLoop>(options_.pollerType);
+      loop->SetEventBatch(options_.eventBatch, options_.maxEventBatch);
+      if (options_.busyPollBudget.count() > 0)
+        loop->SetBusyPoll(options_.busyPollBudget, options_.socketBusyPollUs);
       {
         std::unique_lock<std::mutex> guard(pool_mutex);
         loops_.push_back(loop);
@@ -66,17 +375,84 @@ void TcpServer::_StartWorkers() {
 }
 
 std::shared_ptr<EventLoop> TcpServer::_getNextLoop() {
-  return loops_[next_loop_ind_++ % loops_.size()];
+  switch (options_.placement) {
+  case LoopPlacement::LeastConnections: {
+    auto best = loops_[0];
+    std::size_t bestCount = best->ConnectionCount();
+    for (std::size_t i = 1; i < loops_.size(); ++i) {
+      std::size_t count = loops_[i]->ConnectionCount();
+      if (count < bestCount) {
+        best = loops_[i];
+        bestCount = count;
+      }
+    }
+    return best;
+  }
+  case LoopPlacement::PowerOfTwoChoices: {
+    if (loops_.size() == 1)
+      return loops_[0];
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    std::size_t a = rng() % loops_.size();
+    std::size_t b = rng() % (loops_.size() - 1);
+    if (b >= a)
+      ++b; // 保证两个候选不同
+    auto &la = loops_[a], &lb = loops_[b];
+    double busyA = la->BusyRatio(), busyB = lb->BusyRatio();
+    if (busyA + 0.05 < busyB)
+      return la;
+    if (busyB + 0.05 < busyA)
+      return lb;
+    return la->ConnectionCount() <= lb->ConnectionCount() ? la : lb;
+  }
+  case LoopPlacement::RoundRobin:
+  default:
+    return loops_[next_loop_ind_++ % loops_.size()];
+  }
+}
+
+std::vector<LoopLoad> TcpServer::LoopLoads() const {
+  std::vector<LoopLoad> loads;
+  loads.reserve(loops_.size());
+  for (auto &loop : loops_)
+    loads.push_back(loop->Load());
+  return loads;
+}
+
+std::vector<LoopMetrics> TcpServer::LoopMetricsSnapshot() const {
+  std::vector<LoopMetrics> metrics;
+  metrics.reserve(loops_.size());
+  for (auto &loop : loops_)
+    metrics.push_back(loop->Metrics());
+  return metrics;
 }
 
 void TcpServer::makeNewConnection(int connfd, const sockaddr_in &peer) {
-  // auto server = this;
-  // auto loop = server->_getNextLoop();
   auto loop = _getNextLoop();
-  auto func = [loop, connfd, peer]() {
-    auto conn(std::make_shared<Connection>(loop));
-    conn->Init(connfd, peer);
-    loop->Register(EPOLL_ET_Read, conn);
+  // 连接在 loop 线程中建立之前先计入, 避免一批 accept 都分到同一个 loop
+  loop->AddPlacing();
+  auto func = [this, loop, connfd, peer]() {
+    newConnectionInLoop(loop, connfd, peer);
+    loop->RemovePlacing();
   };
   loop->RunInThisLoop(func);
+}
+
+std::shared_ptr<Connection>
+TcpServer::newConnectionInLoop(std::shared_ptr<EventLoop> loop, int connfd,
+                               const sockaddr_in &peer) {
+  auto conn(std::make_shared<Connection>(loop));
+  conn->Init(connfd, peer);
+  _SetupConnection(*conn);
+  loop->Register(EPOLL_ET_Read, conn);
+  return conn;
+}
+
+void TcpServer::_SetupConnection(Connection &conn) const {
+  ApplyConnectionOptions(conn.Identifier(), options_.socket);
+  conn.SetQuickAck(options_.socket.quickAck &&
+                   !IsUnixAddress(options_.address));
+  conn.SetWatermarks(options_.sendLowWatermark, options_.sendHighWatermark);
+  conn.SetPauseReadOnHighWatermark(options_.pauseReadOnHighWatermark);
+  if (options_.zeroCopyThreshold > 0)
+    conn.EnableZeroCopy(options_.zeroCopyThreshold);
 }
\ No newline at end of file
@@ -1,11 +1,34 @@
+#ifndef SNOWY_TCPSERVER_H
+#define SNOWY_TCPSERVER_H
+
 #include "Acceptor.hpp"
+#include "Connection.hpp"
 #include "EventLoop.hpp"
+#include "TcpServerOptions.hpp"
 
 class TcpServer {
 private:
   const std::string ipPort_;
   const std::string name_;
   std::atomic<size_t> next_loop_ind_{0};
+  TcpServerOptions options_;
+
+  ///@brief 从旧进程接管的连接
+  struct InheritedConnection {
+    int fd;
+    sockaddr_in peer;
+    std::string pending; // 旧进程已读出未处理的数据
+  };
+  std::vector<int> inheritedListenFds_;
+  std::vector<InheritedConnection> inheritedConns_;
+  // 监听中的 Acceptor 及其所在 loop, 交接时注销
+  std::mutex acceptorsMutex_;
+  std::vector<std::pair<std::shared_ptr<EventLoop>, std::shared_ptr<Acceptor>>>
+      acceptors_;
+  int handoffSock_ = -1; // ServeHandoff 的监听 socket, Start 后交给 handoffThread_
+  std::string handoffPath_;
+  std::thread handoffThread_;
+  std::atomic<bool> stopping_{false};
 
 public:
   std::vector<std::shared_ptr<EventLoop>> loops_;
@@ -13,18 +36,60 @@ public:
   std::shared_ptr<EventLoop> loop_;
 
 public:
-  TcpServer();
+  explicit TcpServer(const TcpServerOptions &options = TcpServerOptions());
   ~TcpServer();
   void Start();
   void Listen();
+  ///@brief 线程安全, 停止所有 loop, Start 随后返回
+  void Stop();
+  /**
+   * @brief 新进程在 Start 之前调用，从旧进程的 path 接管监听 socket 与空闲连接
+   *
+   * Listen 使用接管的监听 socket 代替 bind，连接在 Listen 后分配到 worker
+   * loop。交接中途失败时已收到的 socket 照常使用 (旧进程可能已停止监听)，
+   * 返回 false。
+   */
+  bool TakeOver(const std::string &path);
+  /**
+   * @brief 旧进程在 Start 之前调用，在 path 上等待新进程接管
+   *
+   * 新进程连上后：停止 accept 并交出监听 socket；handoffConnections 时交出
+   * 收发缓冲为空的连接；其余连接继续处理，空闲后逐个关闭，全部关闭或超过
+   * drainTimeout 后 Stop。
+   */
+  bool ServeHandoff(const std::string &path);
+  /**
+   * @brief 每个 worker loop 各自持有一个 SO_REUSEPORT 监听 socket，
+   * 由内核分发新连接，accept 后直接在本 loop 建立连接。需在 Start 前设置
+   */
+  void EnableReusePort(bool on) { options_.reusePort = on; }
+  const TcpServerOptions &Options() const { return options_; }
+  ///@brief 各 worker loop 的负载, 顺序与 loops_ 一致
+  std::vector<LoopLoad> LoopLoads() const;
+  ///@brief 各 worker loop 的运行指标, 不停止 loop; 可用 Merge 汇总
+  std::vector<LoopMetrics> LoopMetricsSnapshot() const;
 
+  ///@brief 单 Acceptor 模式下选择 worker loop 并投递新连接
   virtual void makeNewConnection(int connfd, const sockaddr_in &peer);
+  ///@brief 在 loop 线程中创建并注册连接，子类重写以创建自己的 Connection
+  virtual std::shared_ptr<Connection>
+  newConnectionInLoop(std::shared_ptr<EventLoop> loop, int connfd,
+                      const sockaddr_in &peer);
 
 private:
   void _StartWorkers();
+  void _AddAcceptor(std::shared_ptr<EventLoop> loop, int listenFd,
+                    bool reusePort);
+  void _AdoptInheritedConnections();
+  void _Handoff(int sock);
+  void _Drain();
 
 protected:
   std::shared_ptr<EventLoop> _getNextLoop();
+  ///@brief 把 options_ 中的连接级配置应用到新连接
+  void _SetupConnection(Connection &conn) const;
 
   // void _Listen();
-};
\ No newline at end of file
+};
+
+#endif
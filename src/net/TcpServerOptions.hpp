@@ -0,0 +1,87 @@
+/**
+ * @file TcpServerOptions.hpp
+ * @author JDongChen
+ * @brief TcpServer / RpcServer 的网络与线程配置
+ * @version 0.1
+ * @date 2022-09-03
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_TCPSERVEROPTIONS_H
+#define SNOWY_TCPSERVEROPTIONS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.hpp"
+
+///@brief 新连接分配到 worker loop 的策略
+enum class LoopPlacement {
+  RoundRobin,
+  LeastConnections,  // 连接数最少的 loop
+  PowerOfTwoChoices, // 随机取两个, 选忙碌比例低的, 接近时选连接少的
+};
+
+struct TcpServerOptions {
+  /**
+   * @brief 监听地址, 客户端配置见 TcpClientOptions
+   *
+   * "unix:<path>" 使用 Unix 域 stream socket, 此时忽略 port；path 以 '@'
+   * 开头为抽象命名空间, 否则为文件路径, 只删除无人监听的遗留文件
+   */
+  std::string address = "0.0.0.0";
+  uint16_t port = 2468;
+  int backlog = 1024;
+  ///@brief IO loop 数量, 0 表示 std::thread::hardware_concurrency()
+  std::size_t numLoops = 0;
+  ///@brief 第 i 个 loop 绑定到 cpuAffinity[i % size()], 为空则不绑核
+  std::vector<int> cpuAffinity;
+  ///@brief 第 i 个 loop 线程名为 "<threadName>-<i>", 超过 15 字节截断
+  std::string threadName = "snowy-io";
+  ///@brief 每个 worker loop 各自 SO_REUSEPORT 监听
+  bool reusePort = false;
+  PollerType pollerType = PollerType::Epoll;
+  ///@brief 单 Acceptor 模式下的分配策略, reusePort 时由内核分配
+  LoopPlacement placement = LoopPlacement::RoundRobin;
+  ///@brief 连接发送缓冲水位, 超过 high 时暂停读取对端, 降到 low 后恢复
+  std::size_t sendHighWatermark = 64 * 1024 * 1024;
+  std::size_t sendLowWatermark = 32 * 1024 * 1024;
+  bool pauseReadOnHighWatermark = true;
+  ///@brief 监听与 accept 时应用的 socket 选项
+  SocketOptions socket;
+  ///@brief 不小于该大小的分片以 MSG_ZEROCOPY 发送, 0 表示关闭
+  std::size_t zeroCopyThreshold = 0;
+  ///@brief worker loop 忙轮询预算, 0 表示关闭, 见 EventLoop::SetBusyPoll
+  std::chrono::microseconds busyPollBudget{0};
+  int socketBusyPollUs = 0;
+  ///@brief 每次 Poll 的事件批大小, 取满时翻倍直到 maxEventBatch
+  std::size_t eventBatch = 64;
+  std::size_t maxEventBatch = 4096;
+  ///@brief 交接时同时交出空闲连接, 否则只交出监听 socket, 见 TcpServer::ServeHandoff
+  bool handoffConnections = true;
+  ///@brief 交接后等待剩余连接处理完的最长时间, 超时后直接退出
+  std::chrono::milliseconds drainTimeout{30000};
+
+  std::size_t LoopCount() const {
+    if (numLoops != 0)
+      return numLoops;
+    std::size_t n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+  }
+};
+
+/**
+ * @brief 在第 index 个 loop 线程内调用，设置线程名与 CPU 亲和性
+ */
+void SetupLoopThread(const std::string &threadName,
+                     const std::vector<int> &cpuAffinity, std::size_t index);
+inline void SetupLoopThread(const TcpServerOptions &options,
+                            std::size_t index) {
+  SetupLoopThread(options.threadName, options.cpuAffinity, index);
+}
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file TimerQueue.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-08-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <sys/timerfd.h>
+
+#include <cassert>
+
+#include "EventLoop.hpp"
+#include "TimerQueue.hpp"
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop), armed_(TimePoint::max()) {
+  timerFd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  assert(timerFd_ >= 0 && "timerfd_create failed");
+}
+
+TimerQueue::~TimerQueue() { ::close(timerFd_); }
+
+TimerId TimerQueue::RunAt(TimePoint when, Duration interval, Functor cb) {
+  TimerId id = nextId_++;
+  if (loop_->IsRunningThisLoop()) {
+    _AddInLoop(id, when, interval, std::move(cb));
+    return id;
+  }
+  {
+    std::lock_guard<std::mutex> guard(pendingMutex_);
+    pendingAdds_.insert(id);
+  }
+  auto func = [this, id, when, interval, cb = std::move(cb)]() mutable {
+    {
+      std::lock_guard<std::mutex> guard(pendingMutex_);
+      pendingAdds_.erase(id);
+    }
+    if (cancelled_.erase(id))
+      return; // 取消先于添加到达
+    _AddInLoop(id, when, interval, std::move(cb));
+  };
+  loop_->RunInThisLoop(std::move(func));
+  return id;
+}
+
+void TimerQueue::Cancel(TimerId id) {
+  loop_->RunInThisLoop([this, id]() { _CancelInLoop(id); });
+}
+
+bool TimerQueue::HandleReadEvent() {
+  uint64_t expirations = 0;
+  auto n = ::read(timerFd_, &expirations, sizeof(expirations));
+  if (n != sizeof(expirations) && errno != EAGAIN)
+    return false;
+  armed_ = TimePoint::max();
+  _RunExpired(Clock::now());
+  _Rearm();
+  return true;
+}
+
+bool TimerQueue::HandleWriteEvent() {
+  assert(false);
+  return false;
+}
+
+void TimerQueue::_AddInLoop(TimerId id, TimePoint when, Duration interval,
+                            Functor cb) {
+  auto timer = std::make_shared<Timer>();
+  timer->interval = interval;
+  timer->cb = std::move(cb);
+  timers_.emplace(id, std::move(timer));
+  heap_.emplace(when, id);
+  if (when < armed_)
+    _Rearm();
+}
+
+void TimerQueue::_CancelInLoop(TimerId id) {
+  if (timers_.erase(id) == 0) {
+    std::lock_guard<std::mutex> guard(pendingMutex_);
+    if (pendingAdds_.count(id))
+      cancelled_.insert(id);
+    return;
+  }
+  // 堆中只留下已取消的节点过多时才重建，平摊后取消仍是 O(1)
+  if (heap_.size() > 64 && heap_.size() > 2 * timers_.size())
+    _Compact();
+}
+
+void TimerQueue::_RunExpired(TimePoint now) {
+  while (!heap_.empty() && heap_.top().first <= now) {
+    auto [when, id] = heap_.top();
+    heap_.pop();
+    auto it = timers_.find(id);
+    if (it == timers_.end())
+      continue; // cancelled
+    // 回调中可能 Cancel 自己，持有一份引用保证执行期间 Timer 有效
+    auto timer = it->second;
+    if (timer->interval == Duration::zero()) {
+      timers_.erase(it);
+    } else {
+      auto next = when + timer->interval;
+      heap_.emplace(next > now ? next : now + timer->interval, id);
+    }
+    timer->cb();
+  }
+}
+
+void TimerQueue::_Rearm() {
+  while (!heap_.empty() && timers_.count(heap_.top().second) == 0)
+    heap_.pop();
+
+  itimerspec spec{};
+  if (heap_.empty()) {
+    if (armed_ == TimePoint::max())
+      return;
+    armed_ = TimePoint::max(); // zero it_value disarms the timer
+  } else {
+    armed_ = heap_.top().first;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  armed_.time_since_epoch())
+                  .count();
+    if (ns <= 0)
+      ns = 1;
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+  }
+  ::timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void TimerQueue::_Compact() {
+  std::vector<Entry> live;
+  live.reserve(timers_.size());
+  while (!heap_.empty()) {
+    if (timers_.count(heap_.top().second))
+      live.push_back(heap_.top());
+    heap_.pop();
+  }
+  heap_ = Heap(std::greater<Entry>(), std::move(live));
+}
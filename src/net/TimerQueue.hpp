@@ -0,0 +1,97 @@
+/**
+ * @file TimerQueue.hpp
+ * @author JDongChen
+ * @brief 基于 timerfd 的定时器队列，每个 EventLoop 一个
+ * @version 0.1
+ * @date 2022-08-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_TIMERQUEUE_H
+#define SNOWY_TIMERQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Channel.hpp"
+
+class EventLoop;
+
+using TimerId = uint64_t;
+
+/**
+ * @brief 定时器队列
+ *
+ * 最小堆按到期时间排序，哈希表按 TimerId 保存回调。Cancel 只删除哈希表项，
+ * 堆中残留的过期节点在弹出时跳过 (lazy deletion)，因此取消是 O(1)，
+ * 添加是 O(log n)。timerfd 始终设置为堆顶的到期时间，loop 因此可以一直
+ * 阻塞在 Poll 上，直到下一个定时器到期。
+ *
+ * 跨线程 RunAt 的添加要等 loop 执行任务时才生效，期间 Cancel 在表中找不到
+ * 该定时器，于是记下墓碑，添加到达时直接丢弃。
+ *
+ * 除 RunAt / Cancel 之外的接口只能在所属 loop 线程调用。
+ */
+class TimerQueue : public Channel {
+public:
+  using Clock = std::chrono::steady_clock;
+  using TimePoint = Clock::time_point;
+  using Duration = Clock::duration;
+  using Functor = std::function<void()>;
+
+  explicit TimerQueue(EventLoop *loop);
+  ~TimerQueue();
+
+  TimerQueue(const TimerQueue &) = delete;
+  void operator=(const TimerQueue &) = delete;
+
+  ///@brief 在 when 时刻执行 cb，interval 非零时周期执行，线程安全
+  TimerId RunAt(TimePoint when, Duration interval, Functor cb);
+  ///@brief 取消定时器，线程安全；对已经执行完的一次性定时器无效果
+  void Cancel(TimerId id);
+
+  std::size_t Size() const { return timers_.size(); }
+
+public:
+  int Identifier() const override { return timerFd_; }
+  bool HandleReadEvent() override;
+  bool HandleWriteEvent() override;
+  void HandleErrorEvent() override {}
+
+private:
+  struct Timer {
+    Duration interval;
+    Functor cb;
+  };
+  using Entry = std::pair<TimePoint, TimerId>;
+  using Heap =
+      std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+
+  void _AddInLoop(TimerId id, TimePoint when, Duration interval, Functor cb);
+  void _CancelInLoop(TimerId id);
+  void _RunExpired(TimePoint now);
+  void _Rearm();
+  void _Compact();
+
+  EventLoop *loop_;
+  int timerFd_;
+  std::atomic<TimerId> nextId_{1};
+
+  Heap heap_;
+  std::unordered_map<TimerId, std::shared_ptr<Timer>> timers_;
+  TimePoint armed_; // 当前 timerfd 设置的到期时间, 未设置时为 max()
+
+  std::mutex pendingMutex_;
+  std::unordered_set<TimerId> pendingAdds_; // 跨线程投递、尚未添加的定时器
+  std::unordered_set<TimerId> cancelled_;   // 添加前已取消, 仅 loop 线程
+};
+
+#endif
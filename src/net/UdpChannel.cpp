@@ -0,0 +1,249 @@
+/**
+ * @file UdpChannel.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-09-12
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "EventLoop.hpp"
+#include "UdpChannel.hpp"
+
+// 一条 GSO 消息最多的分段数与负载, 与内核 UDP_MAX_SEGMENTS 及 IPv4 上限一致
+static const std::size_t kMaxGsoSegments = 64;
+static const std::size_t kMaxUdpPayload = 65507;
+// 长时间不可写时未发出字节数的上限, 超过后新数据报直接丢弃
+static const std::size_t kMaxQueuedBytes = 4 * 1024 * 1024;
+
+UdpChannel::UdpChannel(std::shared_ptr<EventLoop> loop, std::size_t batch,
+                       std::size_t maxDatagram)
+    : loop_(loop), batch_(batch), maxDatagram_(maxDatagram) {
+  assert(batch_ > 0 && maxDatagram_ > 0);
+  sock_ = CreateUDPSocket();
+  assert(sock_ >= 0);
+
+  recvArena_.resize(batch_ * maxDatagram_);
+  recvMsgs_.resize(batch_);
+  recvIovs_.resize(batch_);
+  recvAddrs_.resize(batch_);
+  for (std::size_t i = 0; i < batch_; ++i) {
+    recvIovs_[i].iov_base = &recvArena_[i * maxDatagram_];
+    recvIovs_[i].iov_len = maxDatagram_;
+    msghdr &hdr = recvMsgs_[i].msg_hdr;
+    ::memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = &recvAddrs_[i];
+    hdr.msg_iov = &recvIovs_[i];
+    hdr.msg_iovlen = 1;
+  }
+  sendMsgs_.resize(batch_);
+  sendIovs_.resize(batch_);
+  sendCounts_.resize(batch_);
+}
+
+UdpChannel::~UdpChannel() {
+  if (sock_ >= 0)
+    ::close(sock_);
+}
+
+bool UdpChannel::Bind(const std::string &ip, uint16_t port, bool reusePort) {
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (::inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1) {
+    printf("invalid udp address %s\n", ip.c_str());
+    return false;
+  }
+  if (reusePort) {
+    int on = 1;
+    ::setsockopt(sock_, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  }
+  return ::bind(sock_, (sockaddr *)&addr, sizeof(addr)) == 0;
+}
+
+uint16_t UdpChannel::LocalPort() const {
+  sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  if (::getsockname(sock_, (sockaddr *)&addr, &len) != 0)
+    return 0;
+  return ntohs(addr.sin_port);
+}
+
+bool UdpChannel::EnableGso(uint16_t segment) {
+  // 设为 0 不改变行为, 只用来探测内核是否支持
+  int zero = 0;
+  if (segment == 0 ||
+      ::setsockopt(sock_, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) != 0)
+    return false;
+  gsoSegment_ = segment;
+  sendIovs_.resize(batch_ * kMaxGsoSegments);
+  sendControl_.resize(batch_ * CMSG_SPACE(sizeof(uint16_t)));
+  return true;
+}
+
+bool UdpChannel::HandleReadEvent() {
+  while (true) {
+    for (std::size_t i = 0; i < batch_; ++i)
+      recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    int n = ::recvmmsg(sock_, recvMsgs_.data(), batch_, MSG_DONTWAIT, nullptr);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        printf("recvmmsg error: %s\n", strerror(errno));
+      break;
+    }
+    ++stats_.recvCalls;
+    stats_.recvDatagrams += n;
+    for (int i = 0; i < n; ++i) {
+      const msghdr &hdr = recvMsgs_[i].msg_hdr;
+      if (hdr.msg_flags & MSG_TRUNC) {
+        ++stats_.truncated;
+        continue;
+      }
+      if (onMessage_)
+        onMessage_(&recvArena_[i * maxDatagram_], recvMsgs_[i].msg_len,
+                   recvAddrs_[i]);
+    }
+    // 不满一批说明接收队列已空, 之后到达的数据报会再次触发可读
+    if (static_cast<std::size_t>(n) < batch_)
+      break;
+  }
+  // 回调中产生的回复合并成批发送
+  return Flush();
+}
+
+bool UdpChannel::HandleWriteEvent() { return Flush(); }
+
+bool UdpChannel::SendTo(const void *data, std::size_t len,
+                        const sockaddr_in &peer) {
+  if (len > kMaxUdpPayload || _QueuedBytes() + len > kMaxQueuedBytes) {
+    ++stats_.sendErrors;
+    return false;
+  }
+  queue_.push_back(Datagram{sendArena_.size(), len, peer});
+  sendArena_.append(static_cast<const char *>(data), len);
+  if (QueuedDatagrams() >= batch_ && !watchingWrite_)
+    return Flush();
+  return true;
+}
+
+std::size_t UdpChannel::_BuildSendBatch() {
+  const char *base = sendArena_.data();
+  std::size_t msgs = 0, iov = 0, idx = queueHead_;
+  while (msgs < batch_ && idx < queue_.size()) {
+    msghdr &hdr = sendMsgs_[msgs].msg_hdr;
+    ::memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = &queue_[idx].peer;
+    hdr.msg_namelen = sizeof(sockaddr_in);
+    hdr.msg_iov = &sendIovs_[iov];
+
+    std::size_t count = 0, bytes = 0;
+    while (true) {
+      const Datagram &d = queue_[idx + count];
+      sendIovs_[iov + count].iov_base = const_cast<char *>(base + d.offset);
+      sendIovs_[iov + count].iov_len = d.len;
+      bytes += d.len;
+      ++count;
+      // GSO 合并: 同一地址, 除最后一个外长度都等于 segment
+      if (gsoSegment_ == 0 || d.len != gsoSegment_ ||
+          count == kMaxGsoSegments || idx + count == queue_.size())
+        break;
+      const Datagram &next = queue_[idx + count];
+      if (next.len > gsoSegment_ || bytes + next.len > kMaxUdpPayload ||
+          next.peer.sin_port != d.peer.sin_port ||
+          next.peer.sin_addr.s_addr != d.peer.sin_addr.s_addr)
+        break;
+    }
+    hdr.msg_iovlen = count;
+    if (count > 1) {
+      hdr.msg_control = &sendControl_[msgs * CMSG_SPACE(sizeof(uint16_t))];
+      hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+      cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      ::memcpy(CMSG_DATA(cm), &gsoSegment_, sizeof(uint16_t));
+    }
+    sendCounts_[msgs] = count;
+    iov += count;
+    idx += count;
+    ++msgs;
+  }
+  return msgs;
+}
+
+void UdpChannel::_Consume(std::size_t datagrams) {
+  queueHead_ += datagrams;
+  if (queueHead_ == queue_.size()) {
+    queue_.clear();
+    sendArena_.clear();
+    queueHead_ = 0;
+    return;
+  }
+  // 持续入队时队列可能一直不空, 已发部分过半才前移, 每字节均摊只拷贝一次
+  const std::size_t sent = queue_[queueHead_].offset;
+  if (sent < sendArena_.size() / 2)
+    return;
+  sendArena_.erase(0, sent);
+  queue_.erase(queue_.begin(), queue_.begin() + queueHead_);
+  for (Datagram &d : queue_)
+    d.offset -= sent;
+  queueHead_ = 0;
+}
+
+std::size_t UdpChannel::_QueuedBytes() const {
+  if (queueHead_ == queue_.size())
+    return 0;
+  return sendArena_.size() - queue_[queueHead_].offset;
+}
+
+bool UdpChannel::Flush() {
+  while (QueuedDatagrams() > 0) {
+    std::size_t msgs = _BuildSendBatch();
+    int n = ::sendmmsg(sock_, sendMsgs_.data(), msgs, MSG_DONTWAIT);
+    if (n < 0) {
+      const int error = errno;
+      if (error == EINTR)
+        continue;
+      if (error == EAGAIN || error == EWOULDBLOCK) {
+        _WatchWrite(true);
+        return true;
+      }
+      if (error == EIO && gsoSegment_ != 0) {
+        // 设备不支持 GSO 所需的校验和卸载, 退回逐个发送
+        printf("udp gso unsupported by device, disabled\n");
+        gsoSegment_ = 0;
+        continue;
+      }
+      // sendmmsg 只在第一条消息出错时返回 -1, 丢弃它继续发送其余的
+      stats_.sendErrors += sendCounts_[0];
+      _Consume(sendCounts_[0]);
+      continue;
+    }
+    ++stats_.sendCalls;
+    std::size_t sent = 0;
+    for (int i = 0; i < n; ++i)
+      sent += sendCounts_[i];
+    stats_.sentDatagrams += sent;
+    _Consume(sent);
+  }
+  _WatchWrite(false);
+  return true;
+}
+
+void UdpChannel::_WatchWrite(bool on) {
+  if (watchingWrite_ == on)
+    return;
+  watchingWrite_ = on;
+  loop_->Modify(on ? EPOLL_ET_Read | EPOLL_ET_Write : EPOLL_ET_Read, this);
+}
@@ -0,0 +1,122 @@
+/**
+ * @file UdpChannel.hpp
+ * @author JDongChen
+ * @brief UDP socket, recvmmsg / sendmmsg 批量收发, 可选 UDP GSO
+ * @version 0.1
+ * @date 2022-09-12
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_UDPCHANNEL_H
+#define SNOWY_UDPCHANNEL_H
+
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Channel.hpp"
+
+class EventLoop;
+
+///@brief 收发统计, 用于确认批量效果
+struct UdpStats {
+  uint64_t recvCalls = 0;     // recvmmsg 次数
+  uint64_t recvDatagrams = 0; // 收到的数据报
+  uint64_t truncated = 0;     // 超过 maxDatagram 被截断而丢弃的数据报
+  uint64_t sendCalls = 0;     // sendmmsg 次数
+  uint64_t sentDatagrams = 0; // 发出的数据报, GSO 合并的按分段计
+  uint64_t sendErrors = 0;    // 因错误丢弃的待发数据报
+};
+
+/**
+ * @brief UDP 通道
+ *
+ * 可读时用 recvmmsg 一次读入至多 batch 个数据报，接收缓冲在构造时一次
+ * 分配，按槽位循环复用，回调中的 data 只在回调期间有效。
+ *
+ * SendTo 只把数据报拷贝进发送队列，队列满 batch 个、处理完一批接收的
+ * 数据报 (回调中产生的回复因此合并发送) 或调用 Flush 时用 sendmmsg
+ * 批量发出；内核缓冲满时关注可写事件，可写后继续发送。
+ *
+ * 开启 GSO 后，发往同一地址、长度等于 segment 的连续数据报 (最后一个
+ * 可以更短) 合并成一条带 UDP_SEGMENT 的消息，由内核或网卡切分。
+ *
+ * 需以 EPOLL_ET_Read 注册到 loop，除构造外的接口都只能在 loop 线程调用。
+ */
+class UdpChannel : public Channel {
+public:
+  using MessageCallback =
+      std::function<void(const char *data, std::size_t len,
+                         const sockaddr_in &peer)>;
+
+  explicit UdpChannel(std::shared_ptr<EventLoop> loop, std::size_t batch = 64,
+                      std::size_t maxDatagram = 2048);
+  ~UdpChannel();
+  UdpChannel(const UdpChannel &) = delete;
+  void operator=(const UdpChannel &) = delete;
+
+  ///@brief port 为 0 时由内核分配, 用 LocalPort 查询
+  bool Bind(const std::string &ip, uint16_t port, bool reusePort = false);
+  uint16_t LocalPort() const;
+  void SetMessageCallback(MessageCallback cb) { onMessage_ = std::move(cb); }
+  ///@brief 内核不支持 UDP_SEGMENT 时返回 false
+  bool EnableGso(uint16_t segment);
+
+  bool SendTo(const void *data, std::size_t len, const sockaddr_in &peer);
+  ///@brief 发出队列中的数据报, 内核缓冲满时剩余部分等可写后再发
+  bool Flush();
+  std::size_t QueuedDatagrams() const { return queue_.size() - queueHead_; }
+  const UdpStats &Stats() const { return stats_; }
+
+public:
+  int Identifier() const override { return sock_; }
+  bool HandleReadEvent() override;
+  bool HandleWriteEvent() override;
+  void HandleErrorEvent() override {}
+
+private:
+  ///@brief 发送队列中的一个数据报, 数据在 sendArena_ 中
+  struct Datagram {
+    std::size_t offset;
+    std::size_t len;
+    sockaddr_in peer;
+  };
+  ///@brief 从 queueHead_ 开始组装至多 batch_ 条消息
+  std::size_t _BuildSendBatch();
+  ///@brief 出队已发出或丢弃的数据报, 已发部分过半时前移剩余数据
+  void _Consume(std::size_t datagrams);
+  ///@brief 尚未发出的字节数
+  std::size_t _QueuedBytes() const;
+  void _WatchWrite(bool on);
+
+  std::shared_ptr<EventLoop> loop_;
+  int sock_;
+  const std::size_t batch_;
+  const std::size_t maxDatagram_;
+  MessageCallback onMessage_;
+  UdpStats stats_;
+
+  // 接收环: batch_ 个 maxDatagram_ 大小的槽位
+  std::vector<char> recvArena_;
+  std::vector<mmsghdr> recvMsgs_;
+  std::vector<iovec> recvIovs_;
+  std::vector<sockaddr_in> recvAddrs_;
+
+  // 发送队列, [queueHead_, end) 未发出, 已发部分超过一半时前移
+  std::string sendArena_;
+  std::vector<Datagram> queue_;
+  std::size_t queueHead_ = 0;
+  std::vector<mmsghdr> sendMsgs_;
+  std::vector<iovec> sendIovs_;
+  std::vector<std::size_t> sendCounts_; // 每条消息包含的数据报数
+  std::vector<char> sendControl_;
+  uint16_t gsoSegment_ = 0;
+  bool watchingWrite_ = false;
+};
+
+#endif
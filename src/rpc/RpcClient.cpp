@@ -1,4 +1,7 @@
 #include "RpcClient.hpp"
+#include "TcpServerOptions.hpp"
+
+#include <unistd.h>
 
 void RpcClient::handleMethodResponse(std::shared_ptr<Protocol> response) {
   // 获取该调用结果的序列号
@@ -29,32 +32,62 @@ void RpcClient::start() {
   printf("Stopped WorkerEventLoops...\n");
 }
 
-bool RpcClient::connect() {
-  auto local_sock = CreateTCPSocket();
-  struct sockaddr_in addr;
-  char SERVER_IP[] = "127.0.0.1";
-  bzero(&addr, sizeof(addr));
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(2468);
-  addr.sin_addr.s_addr = inet_addr(SERVER_IP);
-  ::connect(local_sock, (struct sockaddr *)&addr, sizeof(addr));
+bool RpcClient::connect() { return asyncConnect().get(); }
+
+std::future<bool> RpcClient::asyncConnect() {
+  auto result = std::make_shared<ConnectResult>();
+  auto future = result->promise.get_future();
+  struct sockaddr_storage addr;
+  socklen_t len;
+  if (!ResolveAddress(options_.address, options_.port, &addr, &len)) {
+    printf("invalid server address %s\n", options_.address.c_str());
+    result->Finish(false);
+    return future;
+  }
   auto loop = _getNextLoop();
-  rpc_session_ = std::make_shared<RpcSession>(loop);
-  rpc_session_->Init(local_sock, addr);
-  auto func =
-      std::bind(&RpcClient::handleMethodResponse, this, std::placeholders::_1);
-  rpc_session_->sethandleMethodResponse(func);
 
-  loop->Register(EPOLL_ET_Read | EPOLL_ET_Write, rpc_session_);
-  return true;
+  if (connector_)
+    connector_->Stop();
+  // Stop 异步执行, 旧 Connector 之后建立的连接由其回调关闭
+  if (connectResult_)
+    connectResult_->Finish(false);
+  connectResult_ = result;
+  connector_ = std::make_shared<Connector>(loop, (const sockaddr *)&addr, len);
+  connector_->SetTimeout(options_.connectTimeout);
+  connector_->SetBackoff(options_.reconnectInitialDelay,
+                         options_.reconnectMaxDelay);
+  connector_->SetMaxRetries(options_.connectRetries);
+  connector_->SetSocketOptions(options_.socket);
+  // 回调都在 loop 线程执行, rpc_session_ 经 promise 对调用者可见
+  connector_->setMakeNewConnection(
+      [this, loop, result](int connfd, const sockaddr_in &peer) {
+        if (!result->Claim()) {
+          ::close(connfd);
+          return;
+        }
+        auto session = std::make_shared<RpcSession>(loop);
+        session->Init(connfd, peer);
+        session->SetQuickAck(options_.socket.quickAck &&
+                             !IsUnixAddress(options_.address));
+        auto func = std::bind(&RpcClient::handleMethodResponse, this,
+                              std::placeholders::_1);
+        session->sethandleMethodResponse(func);
+        loop->Register(EPOLL_ET_Read | EPOLL_ET_Write, session);
+        rpc_session_ = session;
+        result->promise.set_value(true);
+      });
+  connector_->SetFailedCallback([result]() { result->Finish(false); });
+  connector_->Start();
+  return future;
 }
 void RpcClient::_startWorkers() {
   std::mutex pool_mutex;
   std::condition_variable cond;
-  std::size_t numLoop = 1;
+  std::size_t numLoop = options_.LoopCount();
   for (size_t i = 0; i < numLoop; ++i) {
-    auto func = [this, &pool_mutex, &cond, numLoop]() {
-      auto loop = std::make_shared<EventLoop>();
+    auto func = [this, &pool_mutex, &cond, numLoop, i]() {
+      SetupLoopThread(options_.threadName, options_.cpuAffinity, i);
+      auto loop = std::make_shared<EventLoop>(options_.pollerType);
       {
         std::unique_lock<std::mutex> guard(pool_mutex);
         loops_.push_back(loop);
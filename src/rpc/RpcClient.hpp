@@ -11,10 +11,12 @@
 #ifndef SNOWY_RPCCLIENT_H
 #define SNOWY_RPCCLIENT_H
 
+#include "Connector.hpp"
 #include "Protocol.hpp"
 #include "Rpc.hpp"
 #include "RpcSession.hpp"
 #include "Socket.hpp"
+#include "TcpClientOptions.hpp"
 #include <condition_variable>
 #include <future>
 #include <mutex>
@@ -26,16 +28,40 @@ private:
   std::map<uint32_t, std::shared_ptr<std::promise<std::shared_ptr<Protocol>>>>
       sessionHandle_;
   std::shared_ptr<RpcSession> rpc_session_;
+  std::shared_ptr<Connector> connector_;
   std::vector<std::shared_ptr<EventLoop>> loops_;
   std::vector<std::thread> thread_pool_;
   std::atomic<uint32_t> sequenceId_ = 0;
-  // std::shared_ptr<EventLoop> loop_;
+  TcpClientOptions options_;
+
+  ///@brief 一次 connect 的结果, 被新的 connect 取代时以 false 结束
+  struct ConnectResult {
+    std::promise<bool> promise;
+    std::atomic<bool> done{false};
+    ///@brief 只有第一次调用返回 true, 之后由调用者 set_value
+    bool Claim() { return !done.exchange(true); }
+    void Finish(bool ok) {
+      if (Claim())
+        promise.set_value(ok);
+    }
+  };
+  std::shared_ptr<ConnectResult> connectResult_;
 
 public:
+  ///@brief 默认连接 127.0.0.1:2468, 使用一个 IO loop
   RpcClient() {}
+  explicit RpcClient(const TcpClientOptions &options) : options_(options) {}
   ~RpcClient() {}
   void start();
+  /**
+   * @brief 连接服务端，等待连接建立或重试次数用尽
+   *
+   * connect 在 IO loop 中以非阻塞方式进行，超时与退避见 options_ 中的
+   * connectTimeout / reconnectInitialDelay / connectRetries。
+   */
   bool connect();
+  ///@brief 同 connect, 不等待结果; 未完成的上一次 connect 以 false 结束
+  std::future<bool> asyncConnect();
   /**
    * @brief 有参数的调用
    * @param[in] name 函数名
@@ -71,6 +97,11 @@ public:
 private:
   template <typename R> Result<R> call(Serializer s) {
     Result<R> val;
+    if (!rpc_session_) {
+      val.setCode(RPC_CLOSED);
+      val.setMsg("not connected");
+      return val;
+    }
     auto request = Protocol::Create(Protocol::MsgType::RPC_METHOD_REQUEST,
                                     s.toString(), sequenceId_);
     auto promise = std::make_shared<std::promise<std::shared_ptr<Protocol>>>();
@@ -25,15 +25,15 @@ RpcServer::handleMethodCall(std::shared_ptr<Protocol> request) {
   return response;
 }
 
-void RpcServer::makeNewConnection(int connfd, const sockaddr_in &peer) {
-  auto loop = _getNextLoop();
-  auto func = [loop, connfd, peer, this]() {
-    auto conn(std::make_shared<RpcSession>(loop));
-    auto handleMethodCallFunc =
-        std::bind(&RpcServer::handleMethodCall, this, std::placeholders::_1);
-    conn->Init(connfd, peer);
-    conn->sethandleMethodCall(handleMethodCallFunc);
-    loop->Register(EPOLL_ET_Read, conn);
-  };
-  loop->RunInThisLoop(func);
+std::shared_ptr<Connection>
+RpcServer::newConnectionInLoop(std::shared_ptr<EventLoop> loop, int connfd,
+                               const sockaddr_in &peer) {
+  auto conn(std::make_shared<RpcSession>(loop));
+  auto handleMethodCallFunc =
+      std::bind(&RpcServer::handleMethodCall, this, std::placeholders::_1);
+  conn->Init(connfd, peer);
+  conn->sethandleMethodCall(handleMethodCallFunc);
+  _SetupConnection(*conn);
+  loop->Register(EPOLL_ET_Read, conn);
+  return conn;
 }
\ No newline at end of file
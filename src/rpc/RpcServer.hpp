@@ -36,6 +36,8 @@ private:
   std::unordered_multimap<std::string, std::weak_ptr<RpcSession>> subscribes_;
 
 public:
+  using TcpServer::TcpServer;
+
   /**
    * @brief 处理客户端过程调用请求
    */
@@ -55,7 +57,9 @@ public:
   }
 
 public:
-  void makeNewConnection(int connfd, const sockaddr_in &peer) override;
+  std::shared_ptr<Connection>
+  newConnectionInLoop(std::shared_ptr<EventLoop> loop, int connfd,
+                      const sockaddr_in &peer) override;
 
 protected:
   /**
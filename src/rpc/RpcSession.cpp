@@ -45,12 +45,16 @@ std::shared_ptr<Protocol> RpcSession::recvProtocol() {
 
 // SafeSendProtocol
 void RpcSession::sendProtocol(std::shared_ptr<Protocol> proto) {
-  // encode
+  // 头部单独编码, 内容直接引用 proto 中的 string, 由分片持有 proto 到发送完成
   auto func = [proto, this]() {
-    std::shared_ptr<ByteArray> ByteArray = proto->encode();
+    std::shared_ptr<ByteArray> meta = proto->encodeMeta();
+    const std::string &content = proto->getContent();
+    IoSlice slices[2] = {
+        {meta, meta->readAddr(), meta->readableSize()},
+        {proto, content.data(), content.size()},
+    };
     std::lock_guard<std::mutex> lock(pro_mutex_);
-    send_buf_.pushData(ByteArray->readAddr(), ByteArray->readableSize());
-    loop_->Modify(EPOLL_ET_Write | EPOLL_ET_Read, shared_from_this());
+    Send(slices, content.empty() ? 1 : 2);
   };
   loop_->RunInThisLoop(func);
 }
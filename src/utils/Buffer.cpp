@@ -10,6 +10,8 @@
  */
 
 #include "Buffer.hpp"
+#include <sys/uio.h>
+
 #include <cassert>
 #include <cstring>
 
@@ -106,4 +108,26 @@ void Buffer::consume(std::size_t bytes) {
 void Buffer::produce(std::size_t bytes) {
   assert(writePos_ + bytes <= capacity_);
   writePos_ += bytes;
-}
\ No newline at end of file
+}
+
+ssize_t Buffer::readFd(int fd) {
+  static thread_local char spill[64 * 1024];
+  const std::size_t writable = writableSize();
+  iovec iov[2];
+  iov[0].iov_base = &buffer_[writePos_];
+  iov[0].iov_len = writable;
+  iov[1].iov_base = spill;
+  iov[1].iov_len = sizeof(spill);
+  // 空闲空间已经足够大时不需要溢出区
+  const int iovcnt = writable < sizeof(spill) ? 2 : 1;
+  const ssize_t n = ::readv(fd, iov, iovcnt);
+  if (n <= 0)
+    return n;
+  if (static_cast<std::size_t>(n) <= writable) {
+    produce(n);
+  } else {
+    produce(writable);
+    pushData(spill, n - writable);
+  }
+  return n;
+}
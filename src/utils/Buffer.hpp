@@ -12,6 +12,8 @@
 #ifndef SNOWY_BUFFER_H
 #define SNOWY_BUFFER_H
 
+#include <sys/types.h>
+
 #include <limits>
 #include <memory>
 #include <vector>
@@ -54,6 +56,14 @@ public:
 
 public:
   void AssureSpace(std::size_t size);
+  /**
+   * @brief 从 fd 读取数据追加到 buffer
+   *
+   * readv 同时读入空闲空间与 64KB 线程局部溢出区，溢出部分再追加进来，
+   * 一次系统调用即可读完大块数据，小消息也不会预先扩容。
+   * @return 同 ::readv，出错时 errno 有效
+   */
+  ssize_t readFd(int fd);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+/**
+ * @file Histogram.hpp
+ * @author JDongChen
+ * @brief 单写者无锁的对数-线性直方图 (HDR 风格), 用于延迟统计
+ * @version 0.1
+ * @date 2022-09-15
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_HISTOGRAM_H
+#define SNOWY_HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 桶的划分
+ *
+ * 小于 2^kSubBits 的值各占一个桶；之后每个 2 的幂区间均分为 2^kSubBits
+ * 个桶，相对误差不超过 1/2^kSubBits。超过 2^kMaxBits 的值计入最后一个桶。
+ */
+struct HistogramBuckets {
+  static constexpr int kSubBits = 4;
+  static constexpr int kMaxBits = 48; // 以纳秒计约 3 天
+  static constexpr std::size_t kSubCount = std::size_t(1) << kSubBits;
+  static constexpr std::size_t kCount = (kMaxBits - kSubBits + 1) * kSubCount;
+
+  static std::size_t Index(uint64_t value) {
+    if (value < kSubCount)
+      return static_cast<std::size_t>(value);
+    value = std::min<uint64_t>(value, (uint64_t(1) << kMaxBits) - 1);
+    const int msb = 63 - __builtin_clzll(value);
+    const int shift = msb - kSubBits;
+    return ((shift + 1) << kSubBits) + ((value >> shift) & (kSubCount - 1));
+  }
+  ///@brief 落入第 index 个桶的最大值
+  static uint64_t UpperBound(std::size_t index) {
+    if (index < kSubCount)
+      return index;
+    const int shift = static_cast<int>(index >> kSubBits) - 1;
+    const uint64_t low = (kSubCount + (index & (kSubCount - 1))) << shift;
+    return low + (uint64_t(1) << shift) - 1;
+  }
+};
+
+///@brief 直方图在某一时刻的拷贝, 可合并多个 loop 的结果
+struct HistogramSnapshot {
+  std::vector<uint64_t> counts; // 各桶计数, 为空表示没有记录
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+
+  double Mean() const { return count ? static_cast<double>(sum) / count : 0; }
+  ///@brief p 取 0~100, 返回所在桶的上界, 不超过 max
+  uint64_t Percentile(double p) const {
+    if (count == 0)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank)
+        return std::min(HistogramBuckets::UpperBound(i), max);
+    }
+    return max;
+  }
+  void Merge(const HistogramSnapshot &other) {
+    if (counts.size() < other.counts.size())
+      counts.resize(other.counts.size(), 0);
+    for (std::size_t i = 0; i < other.counts.size(); ++i)
+      counts[i] += other.counts[i];
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+  }
+};
+
+/**
+ * @brief 单写者直方图
+ *
+ * Record 只能由同一个线程调用 (如 loop 线程)，每次只有几次 relaxed
+ * load/store，没有 read-modify-write；Snapshot 可在任意线程调用，不阻塞
+ * 写者，各桶之间不保证是同一时刻，count 由各桶求和以保证分位数自洽。
+ */
+class Histogram {
+public:
+  Histogram() = default;
+  Histogram(const Histogram &) = delete;
+  void operator=(const Histogram &) = delete;
+
+  void Record(uint64_t value) {
+    _Add(buckets_[HistogramBuckets::Index(value)], 1);
+    _Add(sum_, value);
+    if (value > max_.load(std::memory_order_relaxed))
+      max_.store(value, std::memory_order_relaxed);
+  }
+
+  HistogramSnapshot Snapshot() const {
+    HistogramSnapshot snap;
+    snap.counts.resize(HistogramBuckets::kCount);
+    for (std::size_t i = 0; i < HistogramBuckets::kCount; ++i) {
+      snap.counts[i] = buckets_[i].load(std::memory_order_relaxed);
+      snap.count += snap.counts[i];
+    }
+    snap.sum = sum_.load(std::memory_order_relaxed);
+    snap.max = max_.load(std::memory_order_relaxed);
+    return snap;
+  }
+
+private:
+  static void _Add(std::atomic<uint64_t> &a, uint64_t v) {
+    a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> buckets_[HistogramBuckets::kCount]{};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file MpscQueue.hpp
+ * @author JDongChen
+ * @brief 侵入式无锁多生产者单消费者队列
+ * @version 0.1
+ * @date 2022-08-28
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_MPSCQUEUE_H
+#define SNOWY_MPSCQUEUE_H
+
+#include <atomic>
+
+/**
+ * @brief 队列节点，元素类型需要继承 MpscNode
+ */
+struct MpscNode {
+  std::atomic<MpscNode *> next_{nullptr};
+};
+
+/**
+ * @brief Vyukov 风格的 MPSC 队列
+ *
+ * Push 只有一次 exchange 和一次 store，任意线程可调用且不会阻塞；
+ * Pop 只能由唯一的消费者线程调用。生产者在 exchange 与 store 之间被
+ * 挂起时，消费者会暂时看到队列为空，该节点在下一次 Pop 时可见。
+ * 队列不负责节点的内存，弹出的节点由调用者释放。
+ */
+template <typename T> class MpscQueue {
+public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+  MpscQueue(const MpscQueue &) = delete;
+  void operator=(const MpscQueue &) = delete;
+
+  void Push(T *node) { _Push(node); }
+
+  T *Pop() {
+    MpscNode *tail = tail_;
+    MpscNode *next = tail->next_.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr)
+        return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->next_.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail_ = next;
+      return static_cast<T *>(tail);
+    }
+    // tail 是最后一个节点, 或者有生产者尚未完成链接
+    if (tail != head_.load(std::memory_order_acquire))
+      return nullptr;
+    _Push(&stub_);
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return static_cast<T *>(tail);
+    }
+    return nullptr;
+  }
+
+  ///@brief 消费者线程调用，近似判断
+  bool Empty() const {
+    return tail_ == &stub_ &&
+           stub_.next_.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  void _Push(MpscNode *node) {
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    MpscNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next_.store(node, std::memory_order_release);
+  }
+
+  alignas(64) std::atomic<MpscNode *> head_; // 生产者端
+  alignas(64) MpscNode *tail_;               // 消费者端
+  MpscNode stub_;
+};
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file bench_busy_poll.cpp
+ * @author JDongChen
+ * @brief 对比阻塞等待与忙轮询下的回环 ping-pong 往返延迟, 并检查空闲退避
+ * @version 0.1
+ * @date 2022-09-08
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "EventLoop.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class EchoConnection : public Connection {
+public:
+  using Connection::Connection;
+  void processMessage() override {
+    char buf[64];
+    std::size_t n = recv_buf_.popData(buf, sizeof(buf));
+    Send(buf, n);
+  }
+};
+
+static void Bench(const char *name, std::chrono::microseconds budget,
+                  int rounds) {
+  auto [sfd, cfd] = MakeTcpPair(true);
+  std::promise<std::shared_ptr<EventLoop>> ready;
+  std::thread server([&, sfd = sfd]() {
+    auto loop = std::make_shared<EventLoop>();
+    loop->SetBusyPoll(budget);
+    sockaddr_in peer{};
+    auto conn = std::make_shared<EchoConnection>(loop);
+    conn->Init(sfd, peer);
+    loop->Register(EPOLL_ET_Read, conn);
+    ready.set_value(loop);
+    loop->Run();
+  });
+  auto loop = ready.get_future().get();
+
+  std::vector<double> rtt;
+  rtt.reserve(rounds);
+  char c = 'p';
+  for (int i = 0; i < rounds; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    ::send(cfd, &c, 1, 0);
+    ssize_t n = ::recv(cfd, &c, 1, 0);
+    assert(n == 1);
+    rtt.push_back(std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+  }
+  std::sort(rtt.begin(), rtt.end());
+  double sum = 0;
+  for (double v : rtt)
+    sum += v;
+
+  // 事件稀疏时每次唤醒都让自旋预算减半, 几次之后应退避到 0
+  for (int i = 0; i < 8; ++i) {
+    std::this_thread::sleep_for(10ms);
+    loop->RunInThisLoop([]() {});
+  }
+  std::this_thread::sleep_for(10ms);
+  std::promise<std::chrono::nanoseconds> spin;
+  loop->RunInThisLoop([&]() { spin.set_value(loop->SpinBudget()); });
+  auto idleSpin = spin.get_future().get();
+
+  std::cout << name << "\tavg=" << sum / rounds
+            << "us\tp50=" << rtt[rounds / 2]
+            << "us\tp99=" << rtt[rounds * 99 / 100]
+            << "us\tidle spin budget=" << idleSpin.count() << "ns" << std::endl;
+  assert(idleSpin.count() == 0);
+  loop->Stop();
+  server.join();
+  ::close(cfd);
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? std::atoi(argv[1]) : 20000;
+  Bench("blocking", 0us, rounds);
+  Bench("busy-poll", 50us, rounds);
+  return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file bench_channel_refcount.cpp
+ * @author JDongChen
+ * @brief 对比 EventLoop::Modify 传 shared_from_this() 与裸指针的开销
+ * @version 0.1
+ * @date 2022-09-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "EventLoop.hpp"
+
+#include <sys/eventfd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// 只用于注册的 channel, 不处理任何事件
+class DummyChannel : public Channel {
+public:
+  DummyChannel() : fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+  ~DummyChannel() { ::close(fd_); }
+  int Identifier() const override { return fd_; }
+  bool HandleReadEvent() override { return true; }
+  bool HandleWriteEvent() override { return true; }
+  void HandleErrorEvent() override {}
+
+private:
+  int fd_;
+};
+
+// 兴趣不变的 Modify 是每个请求都会走到的路径 (Connection::_UpdateEvents),
+// 不进入 poller, 开销只剩查表和引用计数
+template <typename F> static double NsPerOp(std::size_t n, F &&op) {
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < n; ++i)
+    op();
+  auto cost = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(cost).count() / n;
+}
+
+int main(int argc, char **argv) {
+  std::size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+  auto loop = std::make_shared<EventLoop>();
+  auto chan = std::make_shared<DummyChannel>();
+  loop->Register(EPOLL_ET_Read, chan);
+  Channel *raw = chan.get();
+
+  // shared_from_this(): weak_ptr 加锁一次 CAS, 临时对象析构一次递减
+  // 裸指针: 没有引用计数操作
+  double shared[2], direct[2];
+  for (int contended = 0; contended < 2; ++contended) {
+    // 另一个线程反复拷贝同一个 shared_ptr, 模拟跨线程投递持有引用
+    std::atomic<bool> stop{false};
+    std::thread other;
+    if (contended) {
+      other = std::thread([&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+          std::shared_ptr<Channel> copy = chan;
+          (void)copy;
+        }
+      });
+    }
+    shared[contended] = NsPerOp(
+        n, [&]() { loop->Modify(EPOLL_ET_Read, raw->shared_from_this()); });
+    direct[contended] =
+        NsPerOp(n, [&]() { loop->Modify(EPOLL_ET_Read, raw); });
+    stop = true;
+    if (other.joinable())
+      other.join();
+  }
+  std::cout << "path\t\tns/op\tns/op(contended)" << std::endl;
+  std::cout << "shared_ptr\t" << shared[0] << "\t" << shared[1] << std::endl;
+  std::cout << "raw\t\t" << direct[0] << "\t" << direct[1] << std::endl;
+  loop->Unregister(EPOLL_ET_Read, raw);
+  return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file bench_common.hpp
+ * @author JDongChen
+ * @brief net 下各 bench 共用的回环连接与计时工具
+ * @version 0.1
+ * @date 2022-09-16
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SNOWY_TESTS_BENCHCOMMON_H
+#define SNOWY_TESTS_BENCHCOMMON_H
+
+#include "Connection.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdint>
+#include <ctime>
+#include <utility>
+
+static const std::size_t kMB = 1024 * 1024;
+
+///@brief 只发送, 收到的数据直接丢弃
+class SinkConnection : public Connection {
+public:
+  using Connection::Connection;
+  void processMessage() override { recv_buf_.clear(); }
+};
+
+///@brief 发送端吞吐与 CPU 开销
+struct Result {
+  double mbps;
+  double cpuPerGB;     // 发送线程每 GB 消耗的 CPU 秒数
+  uint64_t copied = 0; // MSG_ZEROCOPY 时内核回退为拷贝的次数
+};
+
+static inline double ThreadCpuSec() {
+  timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 回环 TCP 连接
+ * @return {服务端 fd (非阻塞, 交给 Connection), 客户端 fd (阻塞)}
+ */
+static inline std::pair<int, int> MakeTcpPair(bool noDelay = false) {
+  int lfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  assert(lfd >= 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int ret = ::bind(lfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  assert(ret == 0);
+  ret = ::listen(lfd, 1);
+  assert(ret == 0);
+  socklen_t len = sizeof(addr);
+  ret = ::getsockname(lfd, reinterpret_cast<sockaddr *>(&addr), &len);
+  assert(ret == 0);
+  int cfd = ::socket(AF_INET, SOCK_STREAM, 0);
+  assert(cfd >= 0);
+  ret = ::connect(cfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  assert(ret == 0);
+  int sfd = ::accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK);
+  assert(sfd >= 0);
+  (void)ret;
+  ::close(lfd);
+  if (noDelay) {
+    int on = 1;
+    ::setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    ::setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+  return {sfd, cfd};
+}
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file bench_nagle.cpp
+ * @author JDongChen
+ * @brief 请求分两次小写发出时 Nagle 与延迟确认叠加的延迟, 以及
+ * TCP_NODELAY / TCP_QUICKACK 的效果
+ * @version 0.1
+ * @date 2022-09-14
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "Connection.hpp"
+#include "EventLoop.hpp"
+#include "Socket.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static const std::size_t kHalf = 8;
+
+// 收齐一个 16 字节请求后才回复, 此前没有数据可以捎带 ACK
+class PingConnection : public Connection {
+public:
+  using Connection::Connection;
+  void processMessage() override {
+    char req[kHalf * 2];
+    while (recv_buf_.readableSize() >= sizeof(req)) {
+      recv_buf_.popData(req, sizeof(req));
+      Send(req, sizeof(req));
+    }
+  }
+};
+
+static bool RecvAll(int fd, char *buf, std::size_t len) {
+  while (len > 0) {
+    ssize_t n = ::recv(fd, buf, len, 0);
+    if (n <= 0)
+      return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+static void Bench(const char *name, const SocketOptions &client,
+                  const SocketOptions &server, int rounds) {
+  int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  ApplyListenOptions(listenFd, server);
+  int ret = ::bind(listenFd, (sockaddr *)&addr, len);
+  assert(ret == 0);
+  ::listen(listenFd, 1);
+  ::getsockname(listenFd, (sockaddr *)&addr, &len);
+
+  int cli = ::socket(AF_INET, SOCK_STREAM, 0);
+  ApplyConnectOptions(cli, client);
+  ret = ::connect(cli, (sockaddr *)&addr, len);
+  assert(ret == 0);
+  (void)ret;
+  ApplyConnectionOptions(cli, client);
+  int srv = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK);
+  ::close(listenFd);
+
+  auto loop = std::make_shared<EventLoop>();
+  auto conn = std::make_shared<PingConnection>(loop);
+  ApplyConnectionOptions(srv, server);
+  conn->Init(srv, addr);
+  conn->SetQuickAck(server.quickAck);
+  loop->Register(EPOLL_ET_Read, conn);
+
+  std::vector<double> rtt;
+  rtt.reserve(rounds);
+  std::thread clientThread([&]() {
+    char req[kHalf * 2] = {0}, res[kHalf * 2];
+    for (int i = 0; i < rounds; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      // 头部与正文分开写, 第二段可能被 Nagle 扣住直到第一段被确认
+      ::send(cli, req, kHalf, 0);
+      ::send(cli, req + kHalf, kHalf, 0);
+      if (!RecvAll(cli, res, sizeof(res)))
+        break;
+      rtt.push_back(std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+    }
+    loop->Stop();
+  });
+  loop->Run();
+  clientThread.join();
+  ::close(cli);
+
+  assert(!rtt.empty());
+  std::sort(rtt.begin(), rtt.end());
+  double sum = 0;
+  for (double v : rtt)
+    sum += v;
+  std::cout << name << "\trounds=" << rtt.size()
+            << "\tavg=" << sum / rtt.size() << "us\tp50=" << rtt[rtt.size() / 2]
+            << "us\tmax=" << rtt.back() << "us" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? std::atoi(argv[1]) : 2000;
+  SocketOptions nagle;
+  nagle.tcpNoDelay = false;
+  SocketOptions noDelay;
+  SocketOptions quickAck = nagle;
+  quickAck.quickAck = true;
+  // 每轮约等一个延迟确认 (~40ms), 少跑几轮
+  Bench("nagle", nagle, nagle, std::min(rounds, 50));
+  Bench("client nodelay", noDelay, nagle, rounds);
+  Bench("server quickack", nagle, quickAck, rounds);
+  return 0;
+}
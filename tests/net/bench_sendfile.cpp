@@ -0,0 +1,106 @@
+/**
+ * @file bench_sendfile.cpp
+ * @author JDongChen
+ * @brief 对比大文件发送: 读入用户态再 Send 与 Connection::SendFile
+ * @version 0.1
+ * @date 2022-09-06
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "EventLoop.hpp"
+#include "bench_common.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int MakeFile(std::size_t size) {
+  char path[] = "/tmp/snowy_bench_XXXXXX";
+  int fd = ::mkstemp(path);
+  assert(fd >= 0);
+  ::unlink(path);
+  std::string block(kMB, 'a');
+  for (std::size_t done = 0; done < size; done += block.size()) {
+    ssize_t n = ::write(fd, block.data(), std::min(block.size(), size - done));
+    assert(n > 0);
+  }
+  return fd;
+}
+
+static Result Bench(int file, std::size_t size, bool zeroCopy) {
+  auto loop = std::make_shared<EventLoop>();
+  auto [sfd, cfd] = MakeTcpPair();
+  sockaddr_in peer{};
+  auto conn = std::make_shared<SinkConnection>(loop);
+  conn->Init(sfd, peer);
+  loop->Register(EPOLL_ET_Read, conn);
+
+  // 原有方式: 每次 pread 1MB 到用户态再 Send, 发送队列排空后继续
+  std::size_t offset = 0;
+  std::vector<char> chunk(kMB);
+  std::function<void()> pump = [&]() {
+    while (offset < size && conn->QueuedBytes() == 0) {
+      ssize_t n = ::pread(file, chunk.data(), chunk.size(), offset);
+      assert(n > 0);
+      offset += n;
+      conn->Send(chunk.data(), n);
+    }
+  };
+  if (!zeroCopy)
+    conn->SetWriteCompleteCallback(pump);
+
+  auto start = std::chrono::steady_clock::now();
+  double cpuStart = ThreadCpuSec();
+  loop->RunInThisLoop([&]() {
+    if (zeroCopy)
+      conn->SendFile(file, 0, size);
+    else
+      pump();
+  });
+  std::thread reader([&]() {
+    std::vector<char> buf(256 * 1024);
+    std::size_t got = 0;
+    while (got < size) {
+      ssize_t n = ::recv(cfd, buf.data(), buf.size(), 0);
+      if (n <= 0)
+        break;
+      got += n;
+    }
+    assert(got == size);
+    loop->Stop();
+  });
+  loop->Run();
+  double cpu = ThreadCpuSec() - cpuStart;
+  reader.join();
+  auto cost = std::chrono::steady_clock::now() - start;
+  ::close(cfd);
+  double sec = std::chrono::duration<double>(cost).count();
+  return Result{size / sec / kMB, cpu / size * 1024 * kMB};
+}
+
+int main(int argc, char **argv) {
+  // ./bench_sendfile [maxMB], 默认测到 1GB
+  std::size_t maxMB = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+  std::cout << "size(MB)\tbuffered(MB/s, cpu s/GB)\tsendfile(MB/s, cpu s/GB)"
+            << std::endl;
+  for (std::size_t mb : {1, 16, 256, 1024}) {
+    if (mb > maxMB)
+      break;
+    int file = MakeFile(mb * kMB);
+    Result buffered = Bench(file, mb * kMB, false);
+    Result zeroCopy = Bench(file, mb * kMB, true);
+    std::cout << mb << "\t\t" << buffered.mbps << ", " << buffered.cpuPerGB
+              << "\t\t" << zeroCopy.mbps << ", " << zeroCopy.cpuPerGB
+              << std::endl;
+    ::close(file);
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file test_acceptor_emfile.cpp
+ * @author JDongChen
+ * @brief fd 耗尽且没有预留 fd 时 Acceptor 暂停监听, 不空转, fd 释放后恢复
+ * @version 0.1
+ * @date 2022-09-16
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "Acceptor.hpp"
+#include "EventLoop.hpp"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+int main() {
+  const int kClients = 4;
+  auto loop = std::make_shared<EventLoop>();
+
+  int listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  int ret = ::bind(listenFd, (sockaddr *)&addr, len);
+  assert(ret == 0);
+  ::listen(listenFd, 16);
+  ::getsockname(listenFd, (sockaddr *)&addr, &len);
+  std::vector<int> clients;
+  for (int i = 0; i < kClients; ++i)
+    clients.push_back(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+
+  // 占满剩余 fd, 使 Acceptor 连预留 fd 都拿不到
+  rlimit old;
+  ::getrlimit(RLIMIT_NOFILE, &old);
+  rlimit limit = old;
+  limit.rlim_cur = 64;
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+  std::vector<int> fillers;
+  for (int fd; (fd = ::dup(0)) >= 0;)
+    fillers.push_back(fd);
+  auto acc = std::make_shared<Acceptor>(loop);
+  acc->Adopt(listenFd);
+  int accepted = 0;
+  acc->setMakeNewConnection([&](int connfd, const sockaddr_in &) {
+    ++accepted;
+    ::close(connfd);
+  });
+  loop->Register(EPOLL_ET_Read | EPOLL_ET_Level, acc);
+
+  for (int fd : clients) {
+    ret = ::connect(fd, (sockaddr *)&addr, len);
+    assert(ret == 0);
+  }
+  // 暂停期间 loop 几乎没有事件; 之后释放 fd, 恢复后全部 accept
+  LoopMetrics starved;
+  loop->RunAfter(250ms, [&]() {
+    starved = loop->Metrics();
+    for (int fd : fillers)
+      ::close(fd);
+    fillers.clear();
+  });
+  loop->RunAfter(500ms, [&]() { loop->Stop(); });
+  loop->Run();
+  ::setrlimit(RLIMIT_NOFILE, &old);
+
+  std::cout << "events while exhausted=" << starved.eventsPerPoll.sum
+            << " accepted=" << accepted << std::endl;
+  assert(starved.eventsPerPoll.sum < 20);
+  assert(accepted == kClients);
+  for (int fd : clients)
+    ::close(fd);
+  return 0;
+}
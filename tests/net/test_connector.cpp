@@ -0,0 +1,178 @@
+/**
+ * @file test_connector.cpp
+ * @author JDongChen
+ * @brief 非阻塞 connect: 拒绝后退避重试, 对端晚启动也能连上, 超时,
+ *        退避为 0 时不空转
+ * @version 0.1
+ * @date 2022-09-11
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "Connector.hpp"
+#include "EventLoop.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+static sockaddr_in Loopback(uint16_t port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return addr;
+}
+
+// 取一个当前没有监听的端口
+static uint16_t UnusedPort() {
+  int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = Loopback(0);
+  ::bind(sock, (sockaddr *)&addr, sizeof(addr));
+  socklen_t len = sizeof(addr);
+  ::getsockname(sock, (sockaddr *)&addr, &len);
+  ::close(sock);
+  return ntohs(addr.sin_port);
+}
+
+static long Ms(Clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+int main() {
+  const uint16_t port = UnusedPort();
+
+  // 1. 一直被拒绝: 重试 3 次后失败, 退避延迟 [10,20] + [20,40] + [40,80] ms
+  {
+    auto loop = std::make_shared<EventLoop>();
+    auto connector = std::make_shared<Connector>(loop, Loopback(port));
+    connector->SetBackoff(20ms, 80ms);
+    connector->SetMaxRetries(3);
+    bool made = false, failed = false;
+    connector->setMakeNewConnection(
+        [&](int, const sockaddr_in &) { made = true; });
+    connector->SetFailedCallback([&]() {
+      failed = true;
+      loop->Stop();
+    });
+    loop->RunAfter(5s, [&]() { loop->Stop(); });
+    auto start = Clock::now();
+    connector->Start();
+    loop->Run();
+    auto cost = Clock::now() - start;
+    std::cout << "refused: failed=" << failed << " cost=" << Ms(cost) << "ms"
+              << std::endl;
+    assert(failed && !made);
+    assert(connector->State() == ConnectState::Failed);
+    assert(cost >= 70ms && cost < 1s);
+  }
+
+  // 2. 对端 150ms 后才开始监听, 重试直到连上
+  {
+    auto loop = std::make_shared<EventLoop>();
+    auto connector = std::make_shared<Connector>(loop, Loopback(port));
+    connector->SetBackoff(20ms, 40ms);
+    int listenFd = -1, connfd = -1;
+    connector->setMakeNewConnection([&](int fd, const sockaddr_in &peer) {
+      assert(peer.sin_port == htons(port));
+      connfd = fd;
+      loop->Stop();
+    });
+    loop->RunAfter(150ms, [&]() {
+      listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+      int on = 1;
+      ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      sockaddr_in addr = Loopback(port);
+      int ret = ::bind(listenFd, (sockaddr *)&addr, sizeof(addr));
+      assert(ret == 0);
+      ::listen(listenFd, 16);
+    });
+    loop->RunAfter(5s, [&]() { loop->Stop(); });
+    auto start = Clock::now();
+    connector->Start();
+    loop->Run();
+    auto cost = Clock::now() - start;
+    std::cout << "late listener: connected=" << (connfd >= 0)
+              << " cost=" << Ms(cost) << "ms" << std::endl;
+    assert(connfd >= 0 && cost >= 150ms);
+    assert(connector->State() == ConnectState::Connected);
+    assert(connector->Identifier() < 0); // fd 已交出
+    int accepted = ::accept(listenFd, nullptr, nullptr);
+    assert(accepted >= 0);
+    ::close(accepted);
+    ::close(connfd);
+    ::close(listenFd);
+  }
+
+  // 3. 对端 accept 队列已满, SYN 被丢弃: 到超时后失败, 期间 loop 不被阻塞
+  {
+    auto loop = std::make_shared<EventLoop>();
+    int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = Loopback(port);
+    ::bind(listenFd, (sockaddr *)&addr, sizeof(addr));
+    ::listen(listenFd, 0);
+    std::vector<int> fillers; // 占满 accept 队列, 从不 accept
+    for (int i = 0; i < 4; ++i) {
+      int sock = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      ::connect(sock, (sockaddr *)&addr, sizeof(addr));
+      fillers.push_back(sock);
+    }
+    std::this_thread::sleep_for(50ms);
+
+    auto connector = std::make_shared<Connector>(loop, addr);
+    connector->SetTimeout(100ms);
+    connector->SetMaxRetries(1);
+    connector->SetBackoff(20ms, 20ms);
+    bool failed = false;
+    int ticks = 0;
+    connector->setMakeNewConnection([&](int fd, const sockaddr_in &) {
+      ::close(fd);
+      loop->Stop();
+    });
+    connector->SetFailedCallback([&]() {
+      failed = true;
+      loop->Stop();
+    });
+    loop->RunEvery(10ms, [&]() { ++ticks; });
+    loop->RunAfter(5s, [&]() { loop->Stop(); });
+    auto start = Clock::now();
+    connector->Start();
+    loop->Run();
+    auto cost = Clock::now() - start;
+    std::cout << "timeout: failed=" << failed << " cost=" << Ms(cost)
+              << "ms ticks=" << ticks << std::endl;
+    // 两次 100ms 超时加一次 [10,20]ms 退避
+    assert(failed && cost >= 210ms && cost < 1s);
+    assert(ticks >= 15);
+    for (int sock : fillers)
+      ::close(sock);
+    ::close(listenFd);
+  }
+
+  // 4. 退避设为 0 仍有最小间隔, 一直被拒绝时 loop 不空转
+  {
+    auto loop = std::make_shared<EventLoop>();
+    auto connector = std::make_shared<Connector>(loop, Loopback(port));
+    connector->SetBackoff(0ms, 0ms);
+    connector->SetMaxRetries(-1);
+    loop->RunAfter(100ms, [&]() {
+      connector->Stop();
+      loop->Stop();
+    });
+    connector->Start();
+    loop->Run();
+    auto iterations = loop->Metrics().iterationNs.count;
+    std::cout << "zero backoff: iterations=" << iterations << std::endl;
+    assert(iterations < 500);
+  }
+  return 0;
+}
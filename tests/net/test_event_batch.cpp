@@ -0,0 +1,68 @@
+/**
+ * @file test_event_batch.cpp
+ * @author JDongChen
+ * @brief Poller 事件批: 取满时翻倍至上限, 每个就绪 fd 只分发一次
+ * @version 0.1
+ * @date 2022-09-11
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "IoUringPoller.hpp"
+#include "Poller.hpp"
+
+#include <sys/eventfd.h>
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+static void Count(void *ctx, void *userPtr, int events) {
+  auto hits = static_cast<std::vector<int> *>(ctx);
+  assert(events & EPOLL_ET_Read);
+  ++(*hits)[reinterpret_cast<std::intptr_t>(userPtr)];
+}
+
+static void Check(Poller &poller, const char *name) {
+  const int kFds = 16;
+  std::vector<int> fds, hits(kFds, 0);
+  poller.SetEventBatch(2, 8);
+  for (int i = 0; i < kFds; ++i) {
+    int fd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC); // 立即可读
+    fds.push_back(fd);
+    poller.Register(fd, EPOLL_ET_Read, reinterpret_cast<void *>(
+                                           static_cast<std::intptr_t>(i)));
+  }
+  std::vector<int> got;
+  std::vector<std::size_t> batches;
+  int total = 0;
+  while (total < kFds) {
+    batches.push_back(poller.EventBatch());
+    int n = poller.Poll(100, &Count, &hits);
+    assert(n > 0);
+    got.push_back(n);
+    total += n;
+  }
+  std::cout << name << ": batches";
+  for (std::size_t b : batches)
+    std::cout << " " << b;
+  std::cout << ", now " << poller.EventBatch() << std::endl;
+  for (int h : hits)
+    assert(h == 1);
+  assert(batches[0] == 2 && poller.EventBatch() == 8);
+  for (int fd : fds) {
+    poller.Unregister(fd, EPOLL_ET_Read);
+    ::close(fd);
+  }
+}
+
+int main() {
+  Epoller epoller;
+  Check(epoller, "epoll");
+  IoUringPoller uring;
+  if (uring.Valid())
+    Check(uring, "io_uring");
+  return 0;
+}
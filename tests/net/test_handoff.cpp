@@ -0,0 +1,134 @@
+/**
+ * @file test_handoff.cpp
+ * @author JDongChen
+ * @brief 进程间交接: 旧进程把监听 socket 和空闲连接交给新进程后退出
+ * @version 0.1
+ * @date 2022-09-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "TcpServer.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static const uint16_t kPort = 2470;
+static const char *kHandoffPath = "@snowy-handoff-test";
+
+// ./test_handoff old|new 作为服务端运行, 不带参数时作为驱动
+static int RunServer(bool takeOver) {
+  TcpServerOptions options;
+  options.address = "127.0.0.1";
+  options.port = kPort;
+  options.numLoops = 2;
+  // 每个 loop 一个监听 socket, 交接时一并交出
+  options.reusePort = true;
+  options.drainTimeout = 5s;
+  TcpServer server(options);
+  if (takeOver && !server.TakeOver(kHandoffPath))
+    return 1;
+  if (!server.ServeHandoff(kHandoffPath))
+    return 1;
+  server.Start();
+  return 0;
+}
+
+static pid_t Spawn(const char *self, const char *mode) {
+  pid_t pid = ::fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    int null = ::open("/dev/null", O_WRONLY);
+    ::dup2(null, STDOUT_FILENO); // 回显连接会打印收到的数据
+    ::execl(self, self, mode, (char *)nullptr);
+    ::_exit(127);
+  }
+  return pid;
+}
+
+static int Connect() {
+  for (int i = 0; i < 100; ++i) {
+    int sock = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(sock, (sockaddr *)&addr, sizeof(addr)) == 0)
+      return sock;
+    ::close(sock);
+    std::this_thread::sleep_for(50ms);
+  }
+  return -1;
+}
+
+static bool Echo(int sock, const std::string &msg) {
+  timeval tv{5, 0};
+  ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (::send(sock, msg.data(), msg.size(), MSG_NOSIGNAL) !=
+      static_cast<ssize_t>(msg.size()))
+    return false;
+  std::string got;
+  char buf[256];
+  while (got.size() < msg.size()) {
+    ssize_t n = ::recv(sock, buf, sizeof(buf), 0);
+    if (n <= 0)
+      return false;
+    got.append(buf, n);
+  }
+  return got == msg;
+}
+
+// 等待子进程退出, 超时返回 false
+static bool WaitExit(pid_t pid, std::chrono::milliseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (::waitpid(pid, nullptr, WNOHANG) == pid)
+      return true;
+    std::this_thread::sleep_for(20ms);
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    return RunServer(std::string(argv[1]) == "new");
+
+  pid_t oldPid = Spawn(argv[0], "old");
+  int idle = Connect();
+  assert(idle >= 0);
+  bool ok = Echo(idle, "before handoff");
+  printf("old process echo: %s\n", ok ? "ok" : "FAIL");
+
+  // 等旧进程开始监听交接路径后再启动新进程, TakeOver 不重试
+  std::this_thread::sleep_for(200ms);
+  pid_t newPid = Spawn(argv[0], "new");
+  bool oldExited = WaitExit(oldPid, 10s);
+  printf("old process exited: %s\n", oldExited ? "yes" : "NO");
+
+  // 空闲连接被新进程接管, 新连接由新进程 accept
+  bool keep = Echo(idle, "after handoff");
+  printf("handed-off connection echo: %s\n", keep ? "ok" : "FAIL");
+  int fresh = Connect();
+  bool accept = fresh >= 0 && Echo(fresh, "new connection");
+  printf("new connection echo: %s\n", accept ? "ok" : "FAIL");
+
+  ::close(idle);
+  ::close(fresh);
+  ::kill(newPid, SIGKILL);
+  ::waitpid(newPid, nullptr, 0);
+  if (!oldExited)
+    ::kill(oldPid, SIGKILL);
+  bool pass = ok && oldExited && keep && accept;
+  printf("%s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file test_loop_metrics.cpp
+ * @author JDongChen
+ * @brief 直方图分桶与分位数; loop 运行中从其他线程取得指标快照
+ * @version 0.1
+ * @date 2022-09-15
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "EventLoop.hpp"
+#include "Histogram.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// 每次可读时读空并忙等一段时间, 模拟慢 handler
+class SlowReader : public Channel {
+public:
+  SlowReader(int fd, std::chrono::microseconds cost) : fd_(fd), cost_(cost) {}
+  int Identifier() const override { return fd_; }
+  bool HandleReadEvent() override {
+    char buf[256];
+    while (::read(fd_, buf, sizeof(buf)) > 0)
+      ++reads_;
+    auto until = std::chrono::steady_clock::now() + cost_;
+    while (std::chrono::steady_clock::now() < until) {
+    }
+    return true;
+  }
+  bool HandleWriteEvent() override { return true; }
+  void HandleErrorEvent() override {}
+  int reads_ = 0;
+
+private:
+  int fd_;
+  std::chrono::microseconds cost_;
+};
+
+static void TestHistogram() {
+  // 分桶覆盖全部取值, 上界单调且误差不超过 1/16
+  for (uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull,
+                     (1ull << 48) - 1}) {
+    std::size_t i = HistogramBuckets::Index(v);
+    assert(i < HistogramBuckets::kCount);
+    uint64_t upper = HistogramBuckets::UpperBound(i);
+    assert(upper >= v && upper - v <= v / 16);
+    assert(i == 0 || HistogramBuckets::UpperBound(i - 1) < v);
+  }
+  assert(HistogramBuckets::Index(1ull << 60) == HistogramBuckets::kCount - 1);
+
+  Histogram h;
+  for (uint64_t v = 1; v <= 10000; ++v)
+    h.Record(v);
+  HistogramSnapshot snap = h.Snapshot();
+  assert(snap.count == 10000 && snap.max == 10000);
+  assert(snap.sum == 10000ull * 10001 / 2);
+  for (double p : {50.0, 90.0, 99.0}) {
+    double expect = p * 100;
+    double got = static_cast<double>(snap.Percentile(p));
+    assert(got >= expect && got <= expect * (1 + 1.0 / 16));
+  }
+  assert(snap.Percentile(100) == 10000);
+
+  HistogramSnapshot merged;
+  merged.Merge(snap);
+  merged.Merge(snap);
+  assert(merged.count == 20000 && merged.Percentile(50) == snap.Percentile(50));
+}
+
+int main() {
+  TestHistogram();
+
+  const int kWrites = 50, kFunctors = 200;
+  std::shared_ptr<EventLoop> loop;
+  std::shared_ptr<SlowReader> reader;
+  int fds[2];
+  int ret = ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  assert(ret == 0);
+  (void)ret;
+
+  std::atomic<bool> ready{false};
+  std::thread loopThread([&]() {
+    loop = std::make_shared<EventLoop>();
+    reader = std::make_shared<SlowReader>(fds[0], 2ms);
+    loop->Register(EPOLL_ET_Read, reader);
+    ready = true;
+    loop->Run();
+  });
+  while (!ready)
+    std::this_thread::sleep_for(1ms);
+
+  // 运行期间取快照, 计数只增不减
+  uint64_t lastIterations = 0;
+  for (int i = 0; i < kWrites; ++i) {
+    ::write(fds[1], "x", 1);
+    for (int j = 0; j < kFunctors / kWrites; ++j)
+      loop->RunInThisLoop([]() {});
+    std::this_thread::sleep_for(3ms);
+    LoopMetrics m = loop->Metrics();
+    assert(m.iterationNs.count >= lastIterations);
+    lastIterations = m.iterationNs.count;
+  }
+  std::this_thread::sleep_for(10ms);
+  LoopMetrics m = loop->Metrics();
+  loop->Stop();
+  loopThread.join();
+
+  std::cout << "iterations=" << m.iterationNs.count
+            << " events=" << m.eventsPerPoll.sum << " functors=" << m.functors
+            << " functorNs=" << m.functorNs.sum << std::endl;
+  std::cout << "iteration p50=" << m.iterationNs.Percentile(50)
+            << "ns p99=" << m.iterationNs.Percentile(99)
+            << "ns; poll p50=" << m.pollNs.Percentile(50)
+            << "ns; handler p50=" << m.handlerNs.Percentile(50)
+            << "ns max=" << m.handlerNs.max << "ns" << std::endl;
+  assert(m.functors == kFunctors);
+  assert(m.iterationNs.count == m.pollNs.count);
+  assert(m.eventsPerPoll.count == m.iterationNs.count);
+  // 每次写入至少触发一次 reader, 另有唤醒 loop 的 notifier 事件
+  assert(m.eventsPerPoll.sum >= kWrites);
+  assert(m.handlerNs.count == m.eventsPerPoll.sum);
+  assert(m.handlerNs.max >= 2000000);
+  // 慢 handler 计入处理时间而非阻塞时间
+  assert(m.iterationNs.Percentile(50) >= 2000000);
+  ::close(fds[0]);
+  ::close(fds[1]);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file test_output_queue.cpp
+ * @author JDongChen
+ * @brief 分片发送队列: 超过 IOV_MAX 的分片、小块拷贝合并与发送顺序
+ * @version 0.1
+ * @date 2022-09-05
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "OutputQueue.hpp"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+int main() {
+  int fds[2];
+  int ret = ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  assert(ret == 0);
+  ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  ::fcntl(fds[1], F_SETFL, ::fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+  OutputQueue queue;
+  std::string expect;
+  // 引用分片多于 IOV_MAX, 需要多次 sendmsg
+  for (int i = 0; i < IOV_MAX + 100; ++i) {
+    auto s = std::make_shared<std::string>(std::to_string(i) + ",");
+    queue.Append(IoSlice{s, s->data(), s->size()});
+    expect += *s;
+    // 穿插小块拷贝, 相邻的拷贝会合并
+    if (i % 7 == 0) {
+      std::string copy = "c" + std::to_string(i) + ";";
+      queue.AppendCopy(copy.data(), copy.size());
+      queue.AppendCopy(copy.data(), copy.size());
+      expect += copy + copy;
+    }
+  }
+  assert(queue.readableSize() == expect.size());
+
+  std::string got;
+  char buf[65536];
+  while (!queue.empty() || got.size() < expect.size()) {
+    bool ok = queue.Flush(fds[0]);
+    assert(ok);
+    ssize_t n;
+    while ((n = ::recv(fds[1], buf, sizeof(buf), 0)) > 0)
+      got.append(buf, n);
+  }
+  std::cout << "bytes=" << got.size() << " match=" << (got == expect)
+            << std::endl;
+  assert(got == expect);
+
+  // 文件区间 (sendfile) 与管道 (splice) 和内存分片按顺序交错
+  {
+    char path[] = "/tmp/snowy_oq_XXXXXX";
+    int file = ::mkstemp(path);
+    assert(file >= 0);
+    ::unlink(path);
+    const std::string content = "0123456789abcdef";
+    ret = ::write(file, content.data(), content.size());
+    assert(ret == static_cast<int>(content.size()));
+    int pfd[2];
+    ret = ::pipe(pfd);
+    assert(ret == 0);
+    ret = ::write(pfd[1], "PIPE", 4);
+    assert(ret == 4);
+
+    queue.AppendCopy("<", 1);
+    queue.AppendFile(file, 4, 8);
+    queue.AppendCopy("|", 1);
+    queue.AppendFile(pfd[0], 0, 4);
+    queue.AppendCopy(">", 1);
+    ::close(file); // 队列持有副本
+    ::close(pfd[0]);
+    ::close(pfd[1]);
+    assert(queue.readableSize() == 3);
+
+    std::string out;
+    while (!queue.empty() || out.size() < 15) {
+      bool ok = queue.Flush(fds[0]);
+      assert(ok);
+      ssize_t n;
+      while ((n = ::recv(fds[1], buf, sizeof(buf), 0)) > 0)
+        out.append(buf, n);
+    }
+    std::cout << "files=" << out << std::endl;
+    assert(out == "<456789ab|PIPE>");
+  }
+
+  // 对端关闭后 Flush 报错
+  ::close(fds[1]);
+  queue.AppendCopy("x", 1);
+  assert(!queue.Flush(fds[0]));
+  ::close(fds[0]);
+  return 0;
+}
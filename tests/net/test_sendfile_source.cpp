@@ -0,0 +1,108 @@
+/**
+ * @file test_sendfile_source.cpp
+ * @author JDongChen
+ * @brief SendFile 的读端 (管道) 暂时无数据时, 数据到达后仍能继续发送;
+ *        一直没有数据时超时关闭连接
+ * @version 0.1
+ * @date 2022-09-16
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "Connection.hpp"
+#include "EventLoop.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace std::chrono_literals;
+
+int main() {
+  auto loop = std::make_shared<EventLoop>();
+  int fds[2];
+  int ret = ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+  assert(ret == 0);
+  int pfd[2];
+  ret = ::pipe(pfd);
+  assert(ret == 0);
+  (void)ret;
+
+  sockaddr_in peer{};
+  auto conn = std::make_shared<Connection>(loop);
+  conn->Init(fds[0], peer);
+  loop->Register(EPOLL_ET_Read, conn);
+  // 管道中还没有数据, 对端 socket 一直可写, 不会再有可写事件
+  bool ok = conn->SendFile(pfd[0], 0, 8);
+  assert(ok);
+  (void)ok;
+
+  std::string got;
+  loop->RunAfter(20ms, [&]() { ::write(pfd[1], "late", 4); });
+  loop->RunAfter(120ms, [&]() { ::write(pfd[1], "data", 4); });
+  loop->RunEvery(5ms, [&]() {
+    char buf[64];
+    ssize_t n;
+    while ((n = ::recv(fds[1], buf, sizeof(buf), 0)) > 0)
+      got.append(buf, n);
+    if (got.size() == 8)
+      loop->Stop();
+  });
+  loop->RunAfter(2s, [&]() { loop->Stop(); });
+  auto start = std::chrono::steady_clock::now();
+  loop->Run();
+  auto cost = std::chrono::steady_clock::now() - start;
+
+  std::cout << "got=" << got << " cost="
+            << std::chrono::duration_cast<std::chrono::milliseconds>(cost)
+                   .count()
+            << "ms" << std::endl;
+  assert(got == "latedata");
+  assert(cost < 1s);
+  ::close(pfd[0]);
+  ::close(pfd[1]);
+  ::close(fds[1]);
+  conn.reset();
+  loop.reset();
+
+  // 管道一直没有数据: 累计等待超过超时后连接被关闭, 不会永远重试
+  {
+    loop = std::make_shared<EventLoop>();
+    ret = ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+    assert(ret == 0);
+    ret = ::pipe(pfd);
+    assert(ret == 0);
+    conn = std::make_shared<Connection>(loop);
+    conn->Init(fds[0], peer);
+    conn->SetSourceStallTimeout(200ms);
+    loop->Register(EPOLL_ET_Read, conn);
+    ok = conn->SendFile(pfd[0], 0, 8);
+    assert(ok);
+
+    bool closed = false;
+    loop->RunEvery(5ms, [&]() {
+      char buf[64];
+      if (::recv(fds[1], buf, sizeof(buf), 0) == 0) {
+        closed = true;
+        loop->Stop();
+      }
+    });
+    loop->RunAfter(2s, [&]() { loop->Stop(); });
+    auto start = std::chrono::steady_clock::now();
+    loop->Run();
+    auto cost = std::chrono::steady_clock::now() - start;
+    std::cout << "idle source: closed=" << closed << " cost="
+              << std::chrono::duration_cast<std::chrono::milliseconds>(cost)
+                     .count()
+              << "ms" << std::endl;
+    assert(closed && cost >= 200ms && cost < 1s);
+    ::close(pfd[0]);
+    ::close(pfd[1]);
+    ::close(fds[1]);
+  }
+  return 0;
+}
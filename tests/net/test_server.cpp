@@ -1,9 +1,35 @@
-
 #include "TcpServer.hpp"
 
-int main() {
+#include <cstdio>
+#include <string>
+
+using namespace std::chrono_literals;
+
+int main(int argc, char **argv) {
+
+  TcpServerOptions options;
+  options.numLoops = 4;
+  // ./test_server [reuseport|least|p2c] [stats]
+  std::string mode = argc > 1 ? argv[1] : "";
+  if (mode == "reuseport")
+    options.reusePort = true;
+  else if (mode == "least")
+    options.placement = LoopPlacement::LeastConnections;
+  else if (mode == "p2c")
+    options.placement = LoopPlacement::PowerOfTwoChoices;
+  TcpServer server(options);
 
-  TcpServer server;
+  // 每秒打印各 loop 的连接数与忙碌比例, 用于确认分配是否均衡
+  if (argc > 2 && std::string(argv[2]) == "stats") {
+    server.loop_->RunEvery(1s, [&server]() {
+      auto loads = server.LoopLoads();
+      for (std::size_t i = 0; i < loads.size(); ++i)
+        printf("loop[%zu] conns=%zu busy=%.3f busyNs=%lu\n", i,
+               loads[i].connections, loads[i].busyRatio,
+               static_cast<unsigned long>(loads[i].busyNs));
+      fflush(stdout);
+    });
+  }
   server.Start();
 
   return 0;
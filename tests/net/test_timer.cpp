@@ -0,0 +1,57 @@
+/**
+ * @file test_timer.cpp
+ * @author JDongChen
+ * @brief
+ * @version 0.1
+ * @date 2022-08-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "EventLoop.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+int main() {
+  EventLoop loop;
+  int once = 0, every = 0, cancelled = 0;
+
+  loop.RunAfter(20ms, [&]() { ++once; });
+  auto id = loop.RunAfter(30ms, [&]() { ++cancelled; });
+  loop.Cancel(id);
+
+  TimerId tick = 0;
+  tick = loop.RunEvery(10ms, [&]() {
+    if (++every == 5)
+      loop.Cancel(tick);
+  });
+
+  // 跨线程添加定时器
+  TimerId late = 0;
+  std::thread other([&]() {
+    loop.RunAfter(100ms, [&loop]() { loop.Stop(); });
+    late = loop.RunAfter(50ms, [&]() { ++cancelled; });
+  });
+  other.join();
+  // 添加仍在 loop 的任务队列中, 取消先于添加生效
+  loop.Cancel(late);
+
+  auto start = std::chrono::steady_clock::now();
+  loop.Run();
+  auto cost = std::chrono::steady_clock::now() - start;
+
+  std::cout << "once=" << once << " every=" << every
+            << " cancelled=" << cancelled << " cost="
+            << std::chrono::duration_cast<std::chrono::milliseconds>(cost)
+                   .count()
+            << "ms" << std::endl;
+  assert(once == 1);
+  assert(every == 5);
+  assert(cancelled == 0);
+  assert(cost >= 100ms);
+  return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file test_unix_listen.cpp
+ * @author JDongChen
+ * @brief Unix 域监听: 遗留的 socket 文件被替换, 仍在监听的路径不被抢占
+ * @version 0.1
+ * @date 2022-09-16
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "Acceptor.hpp"
+#include "EventLoop.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static sockaddr_un UnixAddr(const std::string &path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  ::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+static bool CanConnect(const std::string &path) {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr = UnixAddr(path);
+  bool ok = ::connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+  ::close(fd);
+  return ok;
+}
+
+int main() {
+  const std::string path =
+      "/tmp/snowy_unix_listen_" + std::to_string(::getpid()) + ".sock";
+  auto loop = std::make_shared<EventLoop>();
+
+  // 1. 上次运行遗留的文件: 没有进程监听, 删除后重新监听
+  {
+    int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = UnixAddr(path);
+    int ret = ::bind(stale, (sockaddr *)&addr, sizeof(addr));
+    assert(ret == 0);
+    (void)ret;
+    ::close(stale);
+    assert(!CanConnect(path));
+  }
+  auto acc = std::make_shared<Acceptor>(loop);
+  acc->BindAndListen("unix:" + path, 0);
+  assert(CanConnect(path));
+
+  // 2. 同一路径上再启动一个服务: bind 失败 (断言退出), 原服务不受影响
+  std::fflush(stdout);
+  pid_t pid = ::fork();
+  if (pid == 0) {
+    auto second = std::make_shared<Acceptor>(loop);
+    second->BindAndListen("unix:" + path, 0);
+    ::_exit(0);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  const bool secondFailed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  const bool stillReachable = CanConnect(path);
+  std::cout << "second bind failed=" << secondFailed
+            << " first reachable=" << stillReachable << std::endl;
+  assert(secondFailed && stillReachable);
+
+  acc.reset();
+  ::unlink(path.c_str());
+  return 0;
+}
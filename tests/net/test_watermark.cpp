@@ -0,0 +1,99 @@
+/**
+ * @file test_watermark.cpp
+ * @author JDongChen
+ * @brief 发送缓冲高低水位: 对端不读时暂停读取, 排空后恢复
+ * @version 0.1
+ * @date 2022-09-04
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "Connection.hpp"
+#include "EventLoop.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// 回显连接, 不打印
+class EchoConnection : public Connection {
+public:
+  using Connection::Connection;
+  void processMessage() override {
+    std::string buf(recv_buf_.readableSize(), '\0');
+    recv_buf_.popData(&buf[0], buf.size());
+    Send(buf.data(), buf.size());
+  }
+};
+
+int main() {
+  auto loop = std::make_shared<EventLoop>();
+
+  int fds[2];
+  int ret = ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  assert(ret == 0);
+  ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+  ::fcntl(fds[1], F_SETFL, ::fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+  sockaddr_in peer{};
+  auto conn = std::make_shared<EchoConnection>(loop);
+  conn->Init(fds[0], peer);
+  conn->SetWatermarks(16 * 1024, 256 * 1024);
+  conn->SetPauseReadOnHighWatermark(true);
+  std::size_t highCount = 0, completeCount = 0, maxQueued = 0;
+  conn->SetHighWatermarkCallback([&](std::size_t queued) {
+    ++highCount;
+    maxQueued = std::max(maxQueued, queued);
+  });
+  conn->SetWriteCompleteCallback([&]() { ++completeCount; });
+  loop->Register(EPOLL_ET_Read, conn);
+
+  // 对端只写不读, 直到写不进去 (服务端已暂停读取)
+  const std::string chunk(4096, 'x');
+  std::size_t written = 0, echoed = 0;
+  bool paused = false;
+  char buf[65536];
+  std::thread client([&]() {
+    for (int idle = 0; idle < 50;) {
+      ssize_t n = ::send(fds[1], chunk.data(), chunk.size(), MSG_NOSIGNAL);
+      if (n > 0) {
+        written += n;
+        idle = 0;
+      } else {
+        ++idle;
+        std::this_thread::sleep_for(2ms);
+      }
+    }
+    loop->RunInThisLoop([&]() { paused = conn->ReadPaused(); });
+    // 排空回显数据, 服务端应恢复读取并把剩余数据全部回显
+    for (int idle = 0; idle < 100 && echoed < written;) {
+      ssize_t n = ::recv(fds[1], buf, sizeof(buf), 0);
+      if (n > 0) {
+        echoed += n;
+        idle = 0;
+      } else {
+        ++idle;
+        std::this_thread::sleep_for(2ms);
+      }
+    }
+    loop->Stop();
+  });
+  loop->Run();
+  client.join();
+
+  std::cout << "written=" << written << " echoed=" << echoed
+            << " paused=" << paused << " high=" << highCount
+            << " maxQueued=" << maxQueued << " complete=" << completeCount
+            << std::endl;
+  assert(paused);
+  assert(highCount > 0);
+  assert(completeCount > 0);
+  assert(echoed == written);
+  ::close(fds[1]);
+  return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file bench_unix_rpc.cpp
+ * @author JDongChen
+ * @brief 同一主机上 RpcClient -> RpcServer 走回环 TCP 与 Unix 域 socket 的
+ * 延迟与吞吐对比
+ * @version 0.1
+ * @date 2022-09-13
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "RpcClient.hpp"
+#include "RpcServer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static int add(int a, int b) { return a + b; }
+
+static void Bench(const char *name, const std::string &address, int calls,
+                  int clients) {
+  TcpServerOptions options;
+  options.address = address;
+  options.port = 2471;
+  options.numLoops = 2;
+  options.threadName = "bench-rpc";
+
+  // server 在自己的线程中创建, 其 base loop 属于该线程
+  std::promise<RpcServer *> ready;
+  std::thread serverThread([&]() {
+    RpcServer server(options);
+    server.registerMethod("add", add);
+    ready.set_value(&server);
+    server.Start();
+  });
+  RpcServer *server = ready.get_future().get();
+
+  TcpClientOptions cliOptions;
+  if (address != "0.0.0.0")
+    cliOptions.address = address;
+  cliOptions.port = options.port;
+  cliOptions.threadName = "bench-cli";
+
+  // 单连接串行调用的延迟
+  auto client = std::make_shared<RpcClient>(cliOptions);
+  client->start();
+  std::vector<double> rtt;
+  rtt.reserve(calls);
+  for (int i = 0; i < calls; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    int res = client->call<int>("add", i, 1).getVal();
+    assert(res == i + 1);
+    (void)res;
+    rtt.push_back(std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+  }
+  std::sort(rtt.begin(), rtt.end());
+  double sum = 0;
+  for (double v : rtt)
+    sum += v;
+
+  // 多个连接并发调用的吞吐
+  std::vector<std::shared_ptr<RpcClient>> pool;
+  for (int c = 0; c < clients; ++c) {
+    pool.push_back(std::make_shared<RpcClient>(cliOptions));
+    pool.back()->start();
+  }
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<std::thread> callers;
+  for (auto &cli : pool) {
+    callers.emplace_back([cli, calls]() {
+      for (int i = 0; i < calls; ++i)
+        cli->call<int>("add", i, 2);
+    });
+  }
+  for (auto &t : callers)
+    t.join();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+
+  std::cout << name << "\tavg=" << sum / calls
+            << "us\tp50=" << rtt[calls / 2]
+            << "us\tp99=" << rtt[calls * 99 / 100] << "us\t" << clients
+            << " clients: " << static_cast<long>(clients * calls / seconds)
+            << " calls/s" << std::endl;
+
+  server->Stop();
+  serverThread.join();
+}
+
+int main(int argc, char **argv) {
+  int calls = argc > 1 ? std::atoi(argv[1]) : 20000;
+  int clients = argc > 2 ? std::atoi(argv[2]) : 4;
+  // ./bench_unix_rpc [calls] [clients] [unix:<path>]
+  std::string unixAddress = argc > 3 ? argv[3] : "unix:@snowy-bench-rpc";
+  Bench("tcp", "0.0.0.0", calls, clients);
+  Bench("unix", unixAddress, calls, clients);
+  return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file bench_mpsc_queue.cpp
+ * @author JDongChen
+ * @brief 对比 EventLoop 任务投递: mutex+vector 与无锁 MPSC 队列
+ * @version 0.1
+ * @date 2022-08-28
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "MpscQueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Functor = std::function<void()>;
+
+// 原 EventLoop 的实现: 生产者加锁 emplace_back, 消费者加锁 swap
+class MutexQueue {
+public:
+  void Post(Functor cb) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.emplace_back(std::move(cb));
+  }
+  void Drain() {
+    std::vector<Functor> functors;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      functors.swap(pending_);
+    }
+    for (const Functor &f : functors)
+      f();
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<Functor> pending_;
+};
+
+// 现 EventLoop 的实现
+class LockFreeQueue {
+  struct Node : public MpscNode {
+    explicit Node(Functor f) : fn(std::move(f)) {}
+    Functor fn;
+  };
+
+public:
+  ~LockFreeQueue() { Drain(); }
+  void Post(Functor cb) { queue_.Push(new Node(std::move(cb))); }
+  void Drain() {
+    while (auto node = queue_.Pop())
+      batch_.push_back(node);
+    for (Node *node : batch_) {
+      node->fn();
+      delete node;
+    }
+    batch_.clear();
+  }
+
+private:
+  MpscQueue<Node> queue_;
+  std::vector<Node *> batch_;
+};
+
+template <typename Queue>
+double Bench(std::size_t producers, std::size_t total) {
+  Queue queue;
+  std::atomic<std::size_t> done{0};
+  std::atomic<bool> go{false};
+  const std::size_t perThread = total / producers;
+  const std::size_t expect = perThread * producers;
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < producers; ++i) {
+    threads.emplace_back([&]() {
+      while (!go.load())
+        ;
+      for (std::size_t n = 0; n < perThread; ++n)
+        queue.Post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+  while (done.load(std::memory_order_relaxed) < expect)
+    queue.Drain();
+  auto cost = std::chrono::steady_clock::now() - start;
+  for (auto &t : threads)
+    t.join();
+
+  double sec = std::chrono::duration<double>(cost).count();
+  return expect / sec;
+}
+
+int main(int argc, char **argv) {
+  std::size_t total = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1 << 20;
+  std::cout << "producers\tmutex(Mops/s)\tmpsc(Mops/s)" << std::endl;
+  for (std::size_t p : {1, 2, 4, 8, 16, 32}) {
+    double m = Bench<MutexQueue>(p, total);
+    double l = Bench<LockFreeQueue>(p, total);
+    std::cout << p << "\t\t" << m / 1e6 << "\t\t" << l / 1e6 << std::endl;
+  }
+  return 0;
+}
@@ -1,6 +1,10 @@
 #include "Buffer.hpp"
 #include "Logger.hpp"
 
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
 #include <string>
 #include <thread>
 auto g_log = SNOWY_LOG_ROOT();
@@ -15,8 +19,31 @@ void test() {
   SNOWY_LOG_DEBUG(g_log) << buffer.writableSize();
   SNOWY_LOG_DEBUG(g_log) << buffer.capacity();
 }
+
+// readFd: 小消息只用空闲空间, 大块数据一次 readv 经溢出区读入
+void testReadFd() {
+  int fds[2];
+  int ret = ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  assert(ret == 0);
+  Buffer buffer;
+  ::send(fds[1], "ping", 4, 0);
+  assert(buffer.readFd(fds[0]) == 4);
+  SNOWY_LOG_DEBUG(g_log) << "small read, capacity " << buffer.capacity();
+
+  std::string big(40 * 1024, 'x');
+  ::send(fds[1], big.data(), big.size(), 0);
+  ssize_t n = buffer.readFd(fds[0]);
+  SNOWY_LOG_DEBUG(g_log) << "big read " << n << ", capacity "
+                         << buffer.capacity();
+  assert(n == static_cast<ssize_t>(big.size()));
+  assert(buffer.readableSize() == 4 + big.size());
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
 int main() {
   test();
+  testReadFd();
   std::this_thread::sleep_for(std::chrono::milliseconds(10));
   return 0;
 }
\ No newline at end of file